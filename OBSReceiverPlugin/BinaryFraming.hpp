@@ -0,0 +1,80 @@
+// BinaryFraming.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CommandTable.hpp"
+#include "EventCommand.hpp"
+
+// Binary framing for high-rate senders, which skips tokenizing altogether.
+// A stream connection opts in by sending kBinaryFramingMagic as its very first
+// byte, a datagram by starting with it; anything else is the line protocol.
+// What follows is a sequence of frames:
+//
+//   frame   = varint(length) payload[length]
+//   payload = command*                     applied as one unit, like a line
+//   command = opcode:u8 mask:u8 field*     one field per mask bit, lowest first
+//   opcode  = EventType value
+//   mask    = ArgMask, bit n for ArgKey value n
+//   field   = varint(len << 1) bytes[len]  a name (scene, source, filter)
+//           | varint(id << 1 | 1)          an id from /obsState, as "#id"
+//           | varint(value)                at_ns, in_ms, version, priority,
+//                                          ttl_ms (priority is a Lane value)
+//
+// Varints are LEB128: 7 bits per byte, least significant group first, the high
+// bit set on every byte but the last. Commands are validated exactly like
+// their text form; an empty frame is ignored like an empty line.
+
+// Not printable ASCII, so it never starts a text line or an OSC packet.
+constexpr uint8_t kBinaryFramingMagic = 0xB7;
+
+// Longest accepted payload; longer frames are skipped.
+constexpr size_t kMaxFrameSize = 4096;
+
+// A 64-bit varint takes at most this many bytes.
+constexpr size_t kMaxVarintSize = 10;
+
+// The enum values are the wire format; never renumber them.
+static_assert(static_cast<uint8_t>(EventType::ShowSource) == 0 &&
+		      static_cast<uint8_t>(EventType::HideSource) == 1 &&
+		      static_cast<uint8_t>(EventType::ToggleSource) == 2 &&
+		      static_cast<uint8_t>(EventType::ShowFilter) == 3 &&
+		      static_cast<uint8_t>(EventType::HideFilter) == 4 &&
+		      static_cast<uint8_t>(EventType::ToggleFilter) == 5 &&
+		      static_cast<uint8_t>(EventType::SwitchScene) == 6 &&
+		      static_cast<uint8_t>(EventType::BeginBatch) == 7 &&
+		      static_cast<uint8_t>(EventType::CommitBatch) == 8,
+	      "EventType values are binary opcodes");
+static_assert(static_cast<uint8_t>(ArgKey::SceneName) == 0 && static_cast<uint8_t>(ArgKey::SourceName) == 1 &&
+		      static_cast<uint8_t>(ArgKey::FilterName) == 2 && static_cast<uint8_t>(ArgKey::AtNs) == 3 &&
+		      static_cast<uint8_t>(ArgKey::InMs) == 4 && static_cast<uint8_t>(ArgKey::Version) == 5 &&
+		      static_cast<uint8_t>(ArgKey::Priority) == 6 && static_cast<uint8_t>(ArgKey::TtlMs) == 7,
+	      "ArgKey values are binary mask bits");
+static_assert(static_cast<uint8_t>(Lane::Normal) == 0 && static_cast<uint8_t>(Lane::High) == 1,
+	      "Lane values are binary priorities");
+static_assert(kArgKeyCount <= 8, "the binary mask is one byte");
+
+enum class VarintResult : uint8_t {
+	Ok,
+	Incomplete, // ran out of bytes; more may follow on a stream
+	Malformed,  // longer than kMaxVarintSize
+};
+
+// Decodes a varint from [data, data + size), setting out_size to the bytes it
+// took.
+inline VarintResult read_varint(const uint8_t *data, const size_t size, uint64_t &out, size_t &out_size) noexcept
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < size; ++i) {
+		if (i == kMaxVarintSize)
+			return VarintResult::Malformed;
+		value |= static_cast<uint64_t>(data[i] & 0x7f) << (7 * i);
+		if (!(data[i] & 0x80)) {
+			out = value;
+			out_size = i + 1;
+			return VarintResult::Ok;
+		}
+	}
+	return size >= kMaxVarintSize ? VarintResult::Malformed : VarintResult::Incomplete;
+}
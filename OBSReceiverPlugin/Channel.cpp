@@ -1,36 +1,267 @@
 // Channel.cpp
 #include "Channel.hpp"
 
-bool StringChannel::push(std::string msg) {
+#include <chrono>
+
+const char* overflow_policy_name(OverflowPolicy policy) {
+    switch (policy) {
+    case OverflowPolicy::Block: return "block";
+    case OverflowPolicy::DropNewest: return "drop_newest";
+    case OverflowPolicy::DropOldest: return "drop_oldest";
+    case OverflowPolicy::CoalesceByKey: return "coalesce";
+    }
+    return "unknown";
+}
+
+bool parse_overflow_policy(std::string_view text, OverflowPolicy& out) {
+    if (text == "block") out = OverflowPolicy::Block;
+    else if (text == "drop_newest") out = OverflowPolicy::DropNewest;
+    else if (text == "drop_oldest") out = OverflowPolicy::DropOldest;
+    else if (text == "coalesce") out = OverflowPolicy::CoalesceByKey;
+    else return false;
+    return true;
+}
+
+EventChannel::EventChannel(ChannelOptions options)
+    : policy_(options.policy) {
+    for (std::unique_ptr<LaneQueue>& queue : lanes_) {
+        queue = std::make_unique<LaneQueue>(options.capacity);
+    }
+}
+
+bool EventChannel::push(EventCommand command) {
+    if (closed_.load(std::memory_order_acquire)) return false;
+
+    LaneQueue& queue = lane(lane_of(command));
+    if (policy_ == OverflowPolicy::CoalesceByKey &&
+        queue.overflow_active.load(std::memory_order_acquire)) {
+        return push_overflow(queue, command);
+    }
+
+    while (!queue.ring.try_push(command)) {
+        switch (policy_) {
+        case OverflowPolicy::DropNewest:
+            queue.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+
+        case OverflowPolicy::DropOldest: {
+            EventCommand victim;
+            if (queue.ring.try_pop(victim)) {
+                queue.dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            break;
+        }
+
+        case OverflowPolicy::CoalesceByKey:
+            return push_overflow(queue, command);
+
+        case OverflowPolicy::Block: {
+            std::unique_lock<std::mutex> lock(space_m_);
+            producers_waiting_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            // Timed wait so a missed wake-up costs at most one period.
+            space_cv_.wait_for(lock, std::chrono::milliseconds(50), [&] {
+                return closed_.load(std::memory_order_acquire) ||
+                       queue.ring.size_approx() < queue.ring.capacity();
+            });
+            producers_waiting_.fetch_sub(1, std::memory_order_relaxed);
+            break;
+        }
+        }
+
+        if (closed_.load(std::memory_order_acquire)) return false;
+    }
+
+    queue.accepted.fetch_add(1, std::memory_order_relaxed);
+    note_depth(queue);
+    wake_consumer();
+    return true;
+}
+
+namespace {
+
+// Whether applying command leaves its target in the same state however many
+// times it runs; a toggle does not, so two of them must both stay.
+bool sets_state(const EventCommand& command) {
+    switch (command.type) {
+    case EventType::ShowSource:
+    case EventType::HideSource:
+    case EventType::ShowFilter:
+    case EventType::HideFilter:
+    case EventType::SwitchScene:
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+bool EventChannel::push_overflow(LaneQueue& queue, EventCommand& command) {
+    const CommandTarget key = command_target(command);
     {
-        std::lock_guard<std::mutex> lock(m_);
-        if (closed_) return false;
-        q_.push_back(std::move(msg));
+        std::lock_guard<std::mutex> lock(queue.overflow_m);
+        // The consumer may have emptied the side table since we looked.
+        if (queue.overflow.empty() && queue.ring.try_push(command)) {
+            queue.accepted.fetch_add(1, std::memory_order_relaxed);
+        } else if (EventCommand* parked = coalescible(queue, key, command)) {
+            // Same unit of the same origin, nothing of it in between: the
+            // parked command keeps its place and any line end it carried.
+            const uint8_t ends_line = parked->flags & kCommandEndsLine;
+            *parked = command;
+            parked->flags |= ends_line;
+            queue.coalesced.fetch_add(1, std::memory_order_relaxed);
+        } else if (queue.overflow.size() >= queue.ring.capacity()) {
+            // Too many distinct keys; stay bounded.
+            queue.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            const uint64_t seq = queue.overflow_head + queue.overflow.size();
+            if (sets_state(command)) queue.overflow_index[key] = seq;
+            queue.overflow_last[command.origin] = seq;
+            queue.overflow.push_back(command);
+            queue.overflow_active.store(true, std::memory_order_release);
+            queue.accepted.fetch_add(1, std::memory_order_relaxed);
+        }
     }
-    cv_.notify_one();
+
+    note_depth(queue);
+    wake_consumer();
     return true;
 }
 
-bool StringChannel::pop(std::string& out) {
-    std::unique_lock<std::mutex> lock(m_);
-    cv_.wait(lock, [&] { return closed_ || !q_.empty(); });
+EventCommand* EventChannel::coalescible(LaneQueue& queue, const CommandTarget& key, const EventCommand& command) {
+    if (!sets_state(command)) return nullptr;
+    const auto it = queue.overflow_index.find(key);
+    if (it == queue.overflow_index.end()) return nullptr;
+
+    // Only the origin's latest parked command, so its line and group
+    // boundaries stay where they are. A parked line end only takes a
+    // command that ends a line too, i.e. a whole one-command line; the
+    // first command of a longer one must not join the line before.
+    const auto last = queue.overflow_last.find(command.origin);
+    if (last == queue.overflow_last.end() || last->second != it->second) return nullptr;
+    EventCommand& parked = queue.overflow[static_cast<size_t>(it->second - queue.overflow_head)];
+    if ((parked.flags & kCommandEndsLine) && !(command.flags & kCommandEndsLine)) return nullptr;
+    return &parked;
+}
+
+bool EventChannel::take_overflow(LaneQueue& queue, EventCommand& out) {
+    if (!queue.overflow_active.load(std::memory_order_acquire)) return false;
 
-    if (q_.empty()) return false;
+    std::lock_guard<std::mutex> lock(queue.overflow_m);
+    // Everything parked here arrived after whatever is still in the ring, so
+    // only hand it out once the ring is empty.
+    if (queue.overflow.empty() || !queue.ring.empty_approx()) return false;
 
-    out = std::move(q_.front());
-    q_.pop_front();
+    out = queue.overflow.front();
+    queue.overflow.pop_front();
+    const uint64_t seq = queue.overflow_head++;
+    if (const auto it = queue.overflow_index.find(command_target(out));
+        it != queue.overflow_index.end() && it->second == seq) {
+        queue.overflow_index.erase(it);
+    }
+    if (const auto it = queue.overflow_last.find(out.origin); it != queue.overflow_last.end() && it->second == seq) {
+        queue.overflow_last.erase(it);
+    }
+    if (queue.overflow.empty()) {
+        queue.overflow_active.store(false, std::memory_order_release);
+    }
     return true;
 }
 
-void StringChannel::close() {
+bool EventChannel::any_queued() const {
+    for (const std::unique_ptr<LaneQueue>& queue : lanes_) {
+        if (!queue->ring.empty_approx() || queue->overflow_active.load(std::memory_order_acquire)) return true;
+    }
+    return false;
+}
+
+bool EventChannel::pop(EventCommand& out) {
+    while (true) {
+        if (try_pop(out)) return true;
+        if (closed_.load(std::memory_order_acquire)) {
+            // A producer may have slipped in right before close().
+            return try_pop(out);
+        }
+
+        std::unique_lock<std::mutex> lock(m_);
+        consumer_waiting_.store(true, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv_.wait(lock, [&] { return closed_.load(std::memory_order_acquire) || any_queued(); });
+        consumer_waiting_.store(false, std::memory_order_relaxed);
+    }
+}
+
+bool EventChannel::try_pop(EventCommand& out) {
+    return try_pop(Lane::High, out) || try_pop(Lane::Normal, out);
+}
+
+bool EventChannel::try_pop(Lane which, EventCommand& out) {
+    LaneQueue& queue = lane(which);
+    if (queue.ring.try_pop(out)) {
+        wake_producers();
+        return true;
+    }
+    return take_overflow(queue, out);
+}
+
+void EventChannel::close() {
+    closed_.store(true, std::memory_order_release);
     {
         std::lock_guard<std::mutex> lock(m_);
-        closed_ = true;
+        cv_.notify_all();
     }
-    cv_.notify_all();
+    std::lock_guard<std::mutex> lock(space_m_);
+    space_cv_.notify_all();
 }
 
-bool StringChannel::is_closed() const {
+bool EventChannel::is_closed() const {
+    return closed_.load(std::memory_order_acquire);
+}
+
+ChannelStats EventChannel::stats() const {
+    ChannelStats s;
+    for (size_t i = 0; i < kLaneCount; ++i) {
+        const LaneQueue& queue = *lanes_[i];
+        LaneStats& lane_stats = s.lanes[i];
+        lane_stats.accepted = queue.accepted.load(std::memory_order_relaxed);
+        lane_stats.dropped = queue.dropped.load(std::memory_order_relaxed);
+        lane_stats.coalesced = queue.coalesced.load(std::memory_order_relaxed);
+        lane_stats.high_water = queue.high_water.load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+void EventChannel::note_depth(LaneQueue& queue) {
+    size_t depth = queue.ring.size_approx();
+    if (queue.overflow_active.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(queue.overflow_m);
+        depth += queue.overflow.size();
+    }
+
+    size_t seen = queue.high_water.load(std::memory_order_relaxed);
+    while (depth > seen &&
+           !queue.high_water.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {
+    }
+}
+
+void EventChannel::wake_consumer() {
+    // Pairs with the fence in pop(): either the consumer sees our slot or we
+    // see consumer_waiting_.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!consumer_waiting_.load(std::memory_order_relaxed)) return;
+
     std::lock_guard<std::mutex> lock(m_);
-    return closed_;
+    cv_.notify_one();
+}
+
+void EventChannel::wake_producers() {
+    if (policy_ != OverflowPolicy::Block) return;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (producers_waiting_.load(std::memory_order_relaxed) == 0) return;
+
+    std::lock_guard<std::mutex> lock(space_m_);
+    space_cv_.notify_all();
 }
@@ -1,32 +1,143 @@
 // Channel.hpp
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <deque>
+#include <memory>
 #include <mutex>
-#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 
-class StringChannel {
+#include "EventCommand.hpp"
+#include "MpscRing.hpp"
+
+// What push() does when the channel is already at capacity.
+enum class OverflowPolicy : uint8_t {
+    Block,         // wait for the consumer to make room (backpressure)
+    DropNewest,    // reject the incoming command
+    DropOldest,    // evict the oldest queued command to make room
+    CoalesceByKey, // park in a side table keyed by command_target(); a newer
+                   // show/hide/switch from the same origin replaces the
+                   // parked one if nothing of that origin came in between
+};
+
+const char* overflow_policy_name(OverflowPolicy policy);
+bool parse_overflow_policy(std::string_view text, OverflowPolicy& out);
+
+// Largest accepted capacity: 4 MiB of ring per lane.
+constexpr size_t kMaxChannelCapacity = 64 * 1024;
+
+struct ChannelOptions {
+    size_t capacity = 1024; // per lane, at most kMaxChannelCapacity
+    OverflowPolicy policy = OverflowPolicy::DropNewest;
+};
+
+struct LaneStats {
+    uint64_t accepted = 0;
+    uint64_t dropped = 0;
+    uint64_t coalesced = 0;
+    size_t high_water = 0;
+};
+
+struct ChannelStats {
+    std::array<LaneStats, kLaneCount> lanes;
+};
+
+// Many ingest threads -> one consumer (the OBS tick). Every lane (see
+// lane_of()) is a fixed-size lock-free ring of parsed commands, so push()
+// neither locks nor allocates on the fast path, and a full normal lane never
+// holds up the high one. The overflow policy only comes into play once a
+// lane's ring is full, and only affects that lane.
+class EventChannel {
 public:
-    StringChannel() = default;
-    StringChannel(const StringChannel&) = delete;
-    StringChannel& operator=(const StringChannel&) = delete;
+    explicit EventChannel(ChannelOptions options = {});
+    EventChannel(const EventChannel&) = delete;
+    EventChannel& operator=(const EventChannel&) = delete;
+
+    // Returns false if channel is closed or the command was dropped by the
+    // overflow policy.
+    bool push(EventCommand command);
 
-    // Returns false if channel is closed (message not accepted).
-    bool push(std::string msg);
+    // Blocks until a command is available or the channel is closed+empty.
+    // Returns true if a command was popped, false if closed+empty. Takes from
+    // Lane::High first. Single consumer only, like the try_pop() overloads.
+    bool pop(EventCommand& out);
 
-    // Blocks until a message is available or the channel is closed+empty.
-    // Returns true if a message was popped, false if closed+empty.
-    bool pop(std::string& out);
+    // Never blocks. Returns true if a command was popped.
+    bool try_pop(EventCommand& out);
 
-    // Close the channel. Unblocks pop(). Further push() calls return false.
+    // Never blocks. Like try_pop(), from one lane only. The consumer takes no
+    // more than it can use, so a lane that falls behind fills its ring and
+    // the overflow policy decides what happens to the excess.
+    bool try_pop(Lane lane, EventCommand& out);
+
+    // Close the channel. Unblocks pop() and blocked push() calls. Further
+    // push() calls return false.
     void close();
 
     bool is_closed() const;
 
+    // Of every lane.
+    size_t capacity() const { return lanes_[0]->ring.capacity(); }
+    OverflowPolicy policy() const { return policy_; }
+
+    ChannelStats stats() const;
+
 private:
-    mutable std::mutex m_;
+    struct LaneQueue {
+        explicit LaneQueue(size_t capacity) : ring(capacity) {}
+
+        MpscRing<EventCommand> ring;
+
+        std::atomic<uint64_t> accepted{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> coalesced{0};
+        std::atomic<size_t> high_water{0};
+
+        // CoalesceByKey policy: commands that did not fit in the ring, in
+        // arrival order. While this is non-empty new commands also land here
+        // so that ordering with the ring is preserved. Every parked command
+        // has a sequence number, overflow_head being the one at the front;
+        // the indexes hold sequence numbers, so popping touches only the
+        // entries of the command popped.
+        std::atomic<bool> overflow_active{false};
+        std::mutex overflow_m;
+        std::deque<EventCommand> overflow;
+        uint64_t overflow_head = 0;
+        // Latest parked command per coalescible target.
+        std::unordered_map<CommandTarget, uint64_t, CommandTargetHash> overflow_index;
+        // Latest parked command per origin.
+        std::unordered_map<uint16_t, uint64_t> overflow_last;
+    };
+
+    LaneQueue& lane(Lane which) { return *lanes_[static_cast<size_t>(which)]; }
+
+    bool push_overflow(LaneQueue& lane, EventCommand& command);
+    // The parked command that command may replace, or nullptr. Called with
+    // overflow_m held.
+    EventCommand* coalescible(LaneQueue& lane, const CommandTarget& key, const EventCommand& command);
+    bool take_overflow(LaneQueue& lane, EventCommand& out);
+    bool any_queued() const;
+    void note_depth(LaneQueue& lane);
+    void wake_consumer();
+    void wake_producers();
+
+    std::array<std::unique_ptr<LaneQueue>, kLaneCount> lanes_;
+    const OverflowPolicy policy_;
+    std::atomic<bool> closed_{false};
+
+    // Only used while a consumer is parked in pop(); producers skip the
+    // mutex entirely unless consumer_waiting_ is set.
+    std::atomic<bool> consumer_waiting_{false};
+    std::mutex m_;
     std::condition_variable cv_;
-    std::deque<std::string> q_;
-    bool closed_ = false;
+
+    // Block policy: producers parked waiting for room.
+    std::atomic<uint32_t> producers_waiting_{0};
+    std::mutex space_m_;
+    std::condition_variable space_cv_;
 };
@@ -0,0 +1,218 @@
+// CommandTable.hpp
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "EventCommand.hpp"
+
+// The line protocol in one place. kCommandDefs lists every command with the
+// arguments it takes; the text parser, its validation and the OSC mapping all
+// read it, and command names and argument keys are looked up through perfect
+// hash tables built from it at compile time (one hash and one compare).
+// Adding a command means adding an EventType and a row here.
+
+// "-key value" arguments.
+enum class ArgKey : uint8_t {
+	SceneName,
+	SourceName,
+	FilterName,
+	AtNs,
+	InMs,
+	Version,
+	Priority,
+	TtlMs,
+	Count,
+};
+
+constexpr size_t kArgKeyCount = static_cast<size_t>(ArgKey::Count);
+
+using ArgMask = uint8_t;
+static_assert(kArgKeyCount <= 8, "ArgMask has a bit per key");
+
+constexpr ArgMask arg_bit(const ArgKey key) noexcept
+{
+	return static_cast<ArgMask>(1u << static_cast<unsigned>(key));
+}
+
+struct ArgDef {
+	std::string_view name;
+	ArgKey key;
+};
+
+constexpr std::array<ArgDef, kArgKeyCount> kArgDefs{{
+	{"scene_name", ArgKey::SceneName},
+	{"source_name", ArgKey::SourceName},
+	{"filter_name", ArgKey::FilterName},
+	{"at_ns", ArgKey::AtNs},
+	{"in_ms", ArgKey::InMs},
+	{"version", ArgKey::Version},
+	{"priority", ArgKey::Priority},
+	{"ttl_ms", ArgKey::TtlMs},
+}};
+
+struct CommandDef {
+	std::string_view name;
+	EventType type;
+	ArgMask required; // every one of these
+	ArgMask one_of;   // at least one of these, unless 0
+	ArgMask allowed;  // anything else is rejected
+	// Keys for OSC positional arguments, in order; ArgKey::Count ends the list.
+	std::array<ArgKey, 2> positional;
+};
+
+// Accepted by every command that acts on OBS.
+constexpr ArgMask kCommonArgs = arg_bit(ArgKey::AtNs) | arg_bit(ArgKey::InMs) | arg_bit(ArgKey::Version) |
+				 arg_bit(ArgKey::Priority) | arg_bit(ArgKey::TtlMs);
+constexpr ArgMask kSceneItemArgs = arg_bit(ArgKey::SceneName) | arg_bit(ArgKey::SourceName) | kCommonArgs;
+constexpr ArgMask kFilterArgs =
+	arg_bit(ArgKey::SceneName) | arg_bit(ArgKey::SourceName) | arg_bit(ArgKey::FilterName) | kCommonArgs;
+constexpr ArgMask kFilterOwnerArgs = arg_bit(ArgKey::SceneName) | arg_bit(ArgKey::SourceName);
+
+constexpr std::array<ArgKey, 2> kSceneItemPositional{ArgKey::SceneName, ArgKey::SourceName};
+constexpr std::array<ArgKey, 2> kFilterPositional{ArgKey::SourceName, ArgKey::FilterName};
+constexpr std::array<ArgKey, 2> kNoPositional{ArgKey::Count, ArgKey::Count};
+
+// A scene item without -scene_name is looked up in the current scene; a filter
+// without -source_name lives on the scene. -priority on begin picks the lane of
+// the whole group.
+constexpr std::array<CommandDef, 9> kCommandDefs{{
+	{"show_source", EventType::ShowSource, arg_bit(ArgKey::SourceName), 0, kSceneItemArgs, kSceneItemPositional},
+	{"hide_source", EventType::HideSource, arg_bit(ArgKey::SourceName), 0, kSceneItemArgs, kSceneItemPositional},
+	{"toggle_source", EventType::ToggleSource, arg_bit(ArgKey::SourceName), 0, kSceneItemArgs,
+	 kSceneItemPositional},
+	{"show_filter", EventType::ShowFilter, arg_bit(ArgKey::FilterName), kFilterOwnerArgs, kFilterArgs,
+	 kFilterPositional},
+	{"hide_filter", EventType::HideFilter, arg_bit(ArgKey::FilterName), kFilterOwnerArgs, kFilterArgs,
+	 kFilterPositional},
+	{"toggle_filter", EventType::ToggleFilter, arg_bit(ArgKey::FilterName), kFilterOwnerArgs, kFilterArgs,
+	 kFilterPositional},
+	{"switch_scene", EventType::SwitchScene, arg_bit(ArgKey::SceneName), 0,
+	 arg_bit(ArgKey::SceneName) | kCommonArgs, {ArgKey::SceneName, ArgKey::Count}},
+	{"begin", EventType::BeginBatch, 0, 0, arg_bit(ArgKey::Priority), kNoPositional},
+	{"commit", EventType::CommitBatch, 0, 0, 0, kNoPositional},
+}};
+
+namespace command_table_detail {
+
+constexpr uint32_t hash(const std::string_view text, const uint32_t seed) noexcept
+{
+	uint32_t h = 2166136261u ^ seed;
+	for (const char c : text) {
+		h ^= static_cast<uint8_t>(c);
+		h *= 16777619u;
+	}
+	return h ^ (h >> 15);
+}
+
+// slots[hash & mask] holds 1 + the index of the only name that can be there.
+template <size_t Slots>
+struct PerfectHash {
+	static_assert((Slots & (Slots - 1)) == 0, "slot count must be a power of two");
+	static constexpr uint32_t kMask = Slots - 1;
+
+	uint32_t seed = 0;
+	bool found = false;
+	std::array<uint8_t, Slots> slots{};
+
+	constexpr uint8_t slot_of(const std::string_view name) const noexcept { return slots[hash(name, seed) & kMask]; }
+};
+
+// Tries seeds until no two names share a slot. Runs at compile time only.
+template <size_t Slots, typename Defs>
+constexpr PerfectHash<Slots> build_perfect_hash(const Defs &defs) noexcept
+{
+	static_assert(std::tuple_size<Defs>::value < Slots && std::tuple_size<Defs>::value < 255);
+	PerfectHash<Slots> table{};
+	for (uint32_t seed = 0; seed < 100000; ++seed) {
+		std::array<uint8_t, Slots> slots{};
+		bool collision = false;
+		for (size_t i = 0; i < defs.size() && !collision; ++i) {
+			uint8_t &slot = slots[hash(defs[i].name, seed) & PerfectHash<Slots>::kMask];
+			collision = slot != 0;
+			slot = static_cast<uint8_t>(i + 1);
+		}
+		if (!collision) {
+			table.seed = seed;
+			table.found = true;
+			table.slots = slots;
+			return table;
+		}
+	}
+	return table;
+}
+
+constexpr auto kCommandHash = build_perfect_hash<16>(kCommandDefs);
+constexpr auto kArgHash = build_perfect_hash<16>(kArgDefs);
+static_assert(kCommandHash.found, "no perfect hash seed for kCommandDefs; grow the table");
+static_assert(kArgHash.found, "no perfect hash seed for kArgDefs; grow the table");
+
+// kDefByType[type] holds 1 + the index of the row for type, or 0.
+constexpr std::array<uint8_t, kEventTypeCount> build_def_by_type() noexcept
+{
+	std::array<uint8_t, kEventTypeCount> rows{};
+	for (size_t i = 0; i < kCommandDefs.size(); ++i)
+		rows[static_cast<size_t>(kCommandDefs[i].type)] = static_cast<uint8_t>(i + 1);
+	return rows;
+}
+
+constexpr auto kDefByType = build_def_by_type();
+
+} // namespace command_table_detail
+
+// nullptr for an unknown command.
+constexpr const CommandDef *find_command_def(const std::string_view name) noexcept
+{
+	const uint8_t slot = command_table_detail::kCommandHash.slot_of(name);
+	if (slot == 0)
+		return nullptr;
+	const CommandDef &def = kCommandDefs[slot - 1];
+	return def.name == name ? &def : nullptr;
+}
+
+// ArgKey::Count for an unknown key.
+constexpr ArgKey find_arg_key(const std::string_view name) noexcept
+{
+	const uint8_t slot = command_table_detail::kArgHash.slot_of(name);
+	if (slot == 0)
+		return ArgKey::Count;
+	const ArgDef &def = kArgDefs[slot - 1];
+	return def.name == name ? def.key : ArgKey::Count;
+}
+
+// nullptr for EventType::Unknown or any value without a row; used for binary
+// opcodes, which may hold anything.
+constexpr const CommandDef *command_def_of(const EventType type) noexcept
+{
+	const size_t index = static_cast<size_t>(type);
+	if (index >= command_table_detail::kDefByType.size() || command_table_detail::kDefByType[index] == 0)
+		return nullptr;
+	return &kCommandDefs[command_table_detail::kDefByType[index] - 1];
+}
+
+constexpr std::string_view arg_name(const ArgKey key) noexcept
+{
+	return key == ArgKey::Count ? std::string_view{} : kArgDefs[static_cast<size_t>(key)].name;
+}
+
+namespace command_table_detail {
+
+constexpr bool table_is_consistent() noexcept
+{
+	for (size_t i = 0; i < kArgDefs.size(); ++i) {
+		if (kArgDefs[i].key != static_cast<ArgKey>(i) || find_arg_key(kArgDefs[i].name) != kArgDefs[i].key)
+			return false;
+	}
+	for (const CommandDef &def : kCommandDefs) {
+		if (find_command_def(def.name) != &def || command_def_of(def.type) != &def || (def.required & ~def.allowed) != 0 ||
+		    (def.one_of & ~def.allowed) != 0)
+			return false;
+	}
+	return find_command_def("show") == nullptr && find_arg_key("scene") == ArgKey::Count;
+}
+
+static_assert(table_is_consistent(), "kCommandDefs/kArgDefs and their hash tables disagree");
+
+} // namespace command_table_detail
@@ -0,0 +1,119 @@
+// Config.cpp
+#include "Config.hpp"
+#include "CommandTable.hpp"
+#include "ObsEvents.hpp"
+
+#include <obs-module.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+bool read_env_u64(const char* name, uint64_t& out) {
+    const char* raw = std::getenv(name);
+    if (!raw || !*raw) return false;
+
+    char* end = nullptr;
+    const unsigned long long value = std::strtoull(raw, &end, 10);
+    if (end == raw || *end != '\0') {
+        blog(LOG_WARNING, "[hot-cue-mesh] ignoring invalid %s=%s", name, raw);
+        return false;
+    }
+
+    out = static_cast<uint64_t>(value);
+    return true;
+}
+
+// Like read_env_u64(), but values over max are clamped to it, so the caller's
+// unit conversion cannot overflow.
+bool read_env_u64_max(const char* name, uint64_t max, uint64_t& out) {
+    if (!read_env_u64(name, out)) return false;
+    if (out > max) {
+        blog(LOG_WARNING, "[hot-cue-mesh] %s=%llu is too large; using %llu", name,
+             static_cast<unsigned long long>(out), static_cast<unsigned long long>(max));
+        out = max;
+    }
+    return true;
+}
+
+// A tick may never be given more than a second.
+constexpr uint64_t kMaxTickBudgetUs = 1'000'000;
+
+} // namespace
+
+const char* dispatch_mode_name(DispatchMode mode) {
+    switch (mode) {
+    case DispatchMode::Tick: return "tick";
+    case DispatchMode::Immediate: return "immediate";
+    }
+    return "unknown";
+}
+
+bool parse_dispatch_mode(std::string_view text, DispatchMode& out) {
+    if (text == "tick") out = DispatchMode::Tick;
+    else if (text == "immediate") out = DispatchMode::Immediate;
+    else return false;
+    return true;
+}
+
+PluginConfig load_plugin_config() {
+    PluginConfig config;
+    uint64_t value = 0;
+
+    if (read_env_u64("HOT_CUE_MESH_TICK_MAX_EVENTS", value) && value > 0) {
+        config.tick_drain.max_events = static_cast<size_t>(value);
+    }
+    if (read_env_u64_max("HOT_CUE_MESH_TICK_BUDGET_US", kMaxTickBudgetUs, value) && value > 0) {
+        config.tick_drain.max_ns = value * 1000;
+    }
+    if (const char* raw = std::getenv("HOT_CUE_MESH_DISPATCH"); raw && *raw) {
+        if (!parse_dispatch_mode(raw, config.dispatch)) {
+            blog(LOG_WARNING, "[hot-cue-mesh] ignoring invalid HOT_CUE_MESH_DISPATCH=%s", raw);
+        }
+    }
+    // HOT_CUE_MESH_TTL_MS sets every type, HOT_CUE_MESH_TTL_MS_<COMMAND>
+    // (e.g. HOT_CUE_MESH_TTL_MS_TOGGLE_FILTER) one; 0 disables expiry. Like
+    // -ttl_ms, at most kMaxOffsetMs.
+    if (read_env_u64_max("HOT_CUE_MESH_TTL_MS", kMaxOffsetMs, value)) {
+        config.stale.ttl_ns.fill(value * 1'000'000);
+    }
+    for (const CommandDef& def : kCommandDefs) {
+        if (target_class_of(def.type) == TargetClass::None) continue;
+        std::string name = "HOT_CUE_MESH_TTL_MS_";
+        for (const char c : def.name) {
+            name += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+        if (read_env_u64_max(name.c_str(), kMaxOffsetMs, value)) {
+            config.stale.ttl_ns[static_cast<size_t>(def.type)] = value * 1'000'000;
+        }
+    }
+    if (read_env_u64("HOT_CUE_MESH_CHANNEL_CAPACITY", value) && value > 0) {
+        if (value > kMaxChannelCapacity) {
+            blog(LOG_WARNING, "[hot-cue-mesh] HOT_CUE_MESH_CHANNEL_CAPACITY=%llu is too large; using %zu",
+                 static_cast<unsigned long long>(value), kMaxChannelCapacity);
+            value = kMaxChannelCapacity;
+        }
+        config.channel.capacity = static_cast<size_t>(value);
+    }
+    if (const char* raw = std::getenv("HOT_CUE_MESH_CHANNEL_POLICY"); raw && *raw) {
+        if (!parse_overflow_policy(raw, config.channel.policy)) {
+            blog(LOG_WARNING, "[hot-cue-mesh] ignoring invalid HOT_CUE_MESH_CHANNEL_POLICY=%s", raw);
+        }
+    }
+    if (read_env_u64("HOT_CUE_MESH_UDP_PORT", value) && value <= 0xffff) {
+        config.listener.udp_port = static_cast<unsigned short>(value);
+    }
+    if (const char* raw = std::getenv("HOT_CUE_MESH_LISTENER_BACKEND"); raw && *raw) {
+        config.listener.backend = raw;
+    }
+    if (const char* raw = std::getenv("HOT_CUE_MESH_UNIX_SOCKET"); raw && *raw) {
+        config.listener.unix_socket_path = raw;
+    }
+    if (const char* raw = std::getenv("HOT_CUE_MESH_SHM_NAME"); raw && *raw) {
+        config.listener.shm_name = raw;
+    }
+
+    return config;
+}
@@ -0,0 +1,67 @@
+// Config.hpp
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "Channel.hpp"
+
+// How much work tick_callback may do per OBS tick. Whatever is left over stays
+// queued for the next tick so a burst of events never stalls a frame.
+struct TickDrainBudget {
+    size_t max_events = 64;
+    uint64_t max_ns = 2'000'000;
+};
+
+// When queued commands are executed.
+enum class DispatchMode : uint8_t {
+    Tick,      // on the next OBS tick
+    Immediate, // in a graphics task queued by the ingest thread right away
+};
+
+const char* dispatch_mode_name(DispatchMode mode);
+bool parse_dispatch_mode(std::string_view text, DispatchMode& out);
+
+// How long a command stays worth applying, per EventType, counted from its
+// arrival (or its target time, for timed commands); 0 never expires. Toggles
+// are strobes and go stale after 500 ms by default. Commands that set a state
+// converge on the present however late they run, so they never expire unless
+// configured to.
+struct StaleConfig {
+    std::array<uint64_t, kEventTypeCount> ttl_ns{};
+
+    StaleConfig() {
+        ttl_ns[static_cast<size_t>(EventType::ToggleSource)] = 500'000'000;
+        ttl_ns[static_cast<size_t>(EventType::ToggleFilter)] = 500'000'000;
+    }
+};
+
+// Optional ingest transports next to the TCP listener.
+struct ListenerConfig {
+    // Reactor used on Linux: "epoll" or "io_uring" (falls back to epoll).
+    std::string backend = "epoll";
+    // AF_UNIX stream socket for same-host senders (Linux); empty disables it.
+    std::string unix_socket_path;
+    // UDP/OSC datagrams on 127.0.0.1 (Linux); 0 disables it. Off unless
+    // HOT_CUE_MESH_UDP_PORT is set: LightingController already sends its own
+    // datagrams to udp 7779, next to our TCP port.
+    unsigned short udp_port = 0;
+    // POSIX shared-memory event ring drained on the tick (Linux), e.g.
+    // "/hot-cue-mesh"; empty disables it.
+    std::string shm_name;
+};
+
+struct PluginConfig {
+    TickDrainBudget tick_drain;
+    DispatchMode dispatch = DispatchMode::Tick;
+    StaleConfig stale;
+    // Capacity and overflow behaviour of g_event_channel.
+    ChannelOptions channel;
+    ListenerConfig listener;
+};
+
+// Defaults overridden by HOT_CUE_MESH_* environment variables, if set.
+PluginConfig load_plugin_config();
@@ -0,0 +1,275 @@
+// EpollListener.cpp
+#include "EpollListener.hpp"
+#include "ListenerSockets.hpp"
+
+#include <obs-module.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr int kMaxEpollEvents = 64;
+constexpr size_t kMaxDatagramSize = 65536;
+// Reads per socket per wakeup. Sockets are level-triggered, so whatever is
+// left is reported again by the next epoll_wait(), after every other ready
+// socket had its turn; one fast sender cannot starve the rest.
+constexpr int kMaxReadsPerWakeup = 4;
+constexpr int kMaxDatagramsPerWakeup = 16;
+
+struct Connection {
+    LineAssembler lines;
+};
+
+class EpollReactor {
+public:
+    explicit EpollReactor(LineSink sink) : sink_(std::move(sink)) {}
+
+    ~EpollReactor() {
+        for (auto& entry : connections_) {
+            close(entry.first);
+        }
+        if (tcp_fd_ >= 0) close(tcp_fd_);
+        if (unix_fd_ >= 0) {
+            close(unix_fd_);
+            unlink(unix_path_.c_str());
+        }
+        if (udp_fd_ >= 0) close(udp_fd_);
+        release_message_origin(datagram_origin_);
+        if (wake_fd_ >= 0) close(wake_fd_);
+        if (epoll_fd_ >= 0) close(epoll_fd_);
+    }
+
+    bool open(const ListenerOptions& options) {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd_ < 0 || wake_fd_ < 0) {
+            blog(LOG_ERROR, "[hot-cue-mesh] epoll/eventfd setup failed: %s", std::strerror(errno));
+            return false;
+        }
+        if (!watch(wake_fd_)) {
+            return false;
+        }
+
+        if (options.tcp_port != 0) {
+            tcp_fd_ = adopt(open_tcp_listener(options.tcp_port));
+            if (tcp_fd_ >= 0) {
+                blog(LOG_INFO, "[hot-cue-mesh] listening for hot cue events on 127.0.0.1:%u (epoll)",
+                     options.tcp_port);
+            }
+        }
+        if (!options.unix_path.empty()) {
+            unix_fd_ = adopt(open_unix_listener(options.unix_path));
+            if (unix_fd_ >= 0) {
+                unix_path_ = options.unix_path;
+                blog(LOG_INFO, "[hot-cue-mesh] listening for hot cue events on %s (epoll)",
+                     options.unix_path.c_str());
+            }
+        }
+        if (options.udp_port != 0) {
+            udp_fd_ = adopt(open_udp_socket(options.udp_port));
+            if (udp_fd_ >= 0) {
+                datagram_.resize(kMaxDatagramSize);
+                datagram_origin_ = acquire_message_origin();
+                blog(LOG_INFO, "[hot-cue-mesh] listening for hot cue datagrams on udp 127.0.0.1:%u (epoll)",
+                     options.udp_port);
+            }
+        }
+        return tcp_fd_ >= 0 || unix_fd_ >= 0 || udp_fd_ >= 0;
+    }
+
+    void run() {
+        epoll_event events[kMaxEpollEvents];
+        while (!stopping_) {
+            ++syscalls_;
+            const int ready = epoll_wait(epoll_fd_, events, kMaxEpollEvents, -1);
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                blog(LOG_ERROR, "[hot-cue-mesh] epoll_wait() failed: %s", std::strerror(errno));
+                break;
+            }
+
+            for (int i = 0; i < ready && !stopping_; ++i) {
+                const int fd = events[i].data.fd;
+                if (fd == wake_fd_) {
+                    stopping_ = true;
+                } else if (fd == tcp_fd_ || fd == unix_fd_) {
+                    accept_all(fd);
+                } else if (fd == udp_fd_) {
+                    read_datagrams();
+                } else {
+                    read_client(fd);
+                }
+            }
+        }
+
+        blog(LOG_INFO, "[hot-cue-mesh] epoll listener: %llu lines, %llu frames, %llu syscalls",
+             static_cast<unsigned long long>(lines_), static_cast<unsigned long long>(frames_),
+             static_cast<unsigned long long>(syscalls_));
+    }
+
+    void wake() {
+        const uint64_t one = 1;
+        [[maybe_unused]] const ssize_t written = write(wake_fd_, &one, sizeof(one));
+    }
+
+private:
+    bool watch(int fd) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            blog(LOG_ERROR, "[hot-cue-mesh] epoll_ctl() failed: %s", std::strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    int adopt(int fd) {
+        if (fd >= 0 && !watch(fd)) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    bool deliver(EventMessage message, MessageFormat format, uint16_t origin) {
+        if (format != MessageFormat::End) ++(format == MessageFormat::Frame ? frames_ : lines_);
+        return sink_(std::move(message), format, origin);
+    }
+
+    void accept_all(int listen_fd) {
+        while (true) {
+            ++syscalls_;
+            const int client = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (client < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    blog(LOG_WARNING, "[hot-cue-mesh] accept() failed: %s", std::strerror(errno));
+                }
+                return;
+            }
+
+            if (!watch(client)) {
+                close(client);
+                continue;
+            }
+            connections_.try_emplace(client);
+        }
+    }
+
+    void read_client(int fd) {
+        auto it = connections_.find(fd);
+        if (it == connections_.end()) return;
+        LineAssembler& lines = it->second.lines;
+
+        for (int reads = 0; reads < kMaxReadsPerWakeup;) {
+            // Receive straight into the connection's slab.
+            const auto [area, space] = lines.receive_area();
+            ++syscalls_;
+            const ssize_t bytes_read = recv(fd, area, space, 0);
+            if (bytes_read > 0) {
+                if (!lines.commit(static_cast<size_t>(bytes_read), deliver_)) {
+                    stopping_ = true;
+                    return;
+                }
+                ++reads;
+                continue;
+            }
+            if (bytes_read < 0 && errno == EINTR) continue;
+            if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+
+            // EOF or hard error: flush a trailing unterminated line, then drop.
+            if (!lines.finish(deliver_)) {
+                stopping_ = true;
+            }
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+            close(fd);
+            connections_.erase(it);
+            return;
+        }
+    }
+
+    void read_datagrams() {
+        for (int reads = 0; reads < kMaxDatagramsPerWakeup; ++reads) {
+            ++syscalls_;
+            const ssize_t bytes_read = recv(udp_fd_, datagram_.data(), datagram_.size(), 0);
+            if (bytes_read < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+
+            if (!deliver_datagram(datagram_.data(), static_cast<size_t>(bytes_read), datagram_origin_, deliver_,
+                                  datagram_writer_, datagram_scratch_)) {
+                stopping_ = true;
+                return;
+            }
+        }
+    }
+
+    LineSink sink_;
+    const LineSink deliver_ = [this](EventMessage message, MessageFormat format, uint16_t origin) {
+        return deliver(std::move(message), format, origin);
+    };
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    int tcp_fd_ = -1;
+    int unix_fd_ = -1;
+    std::string unix_path_;
+    int udp_fd_ = -1;
+    std::vector<char> datagram_;
+    SlabWriter datagram_writer_;
+    std::string datagram_scratch_;
+    uint16_t datagram_origin_ = 0;
+    bool stopping_ = false;
+    uint64_t lines_ = 0;
+    uint64_t frames_ = 0;
+    uint64_t syscalls_ = 0;
+    std::unordered_map<int, Connection> connections_;
+};
+
+std::mutex g_mu;
+std::unique_ptr<EpollReactor> g_reactor;
+std::unique_ptr<std::thread> g_thr;
+} // namespace
+
+bool start_epoll_listener(const ListenerOptions& options, LineSink sink) {
+    std::lock_guard<std::mutex> lk(g_mu);
+    if (g_reactor) return true;
+
+    auto reactor = std::make_unique<EpollReactor>(std::move(sink));
+    if (!reactor->open(options)) {
+        return false;
+    }
+
+    g_reactor = std::move(reactor);
+    g_thr = std::make_unique<std::thread>([reactor = g_reactor.get()]() {
+        reactor->run();
+    });
+    return true;
+}
+
+void stop_epoll_listener() {
+    std::unique_ptr<std::thread> thr;
+    std::unique_ptr<EpollReactor> reactor;
+
+    {
+        std::lock_guard<std::mutex> lk(g_mu);
+        thr = std::move(g_thr);
+        reactor = std::move(g_reactor);
+    }
+
+    if (reactor) reactor->wake();
+    if (thr && thr->joinable()) thr->join();
+}
@@ -0,0 +1,8 @@
+// EpollListener.hpp
+#pragma once
+
+#include "Listener.hpp"
+
+// epoll backend of start_event_listener(); use that instead.
+bool start_epoll_listener(const ListenerOptions& options, LineSink sink);
+void stop_epoll_listener();
@@ -0,0 +1,156 @@
+// EventCommand.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <type_traits>
+
+#include "NameTable.hpp"
+
+enum class EventType : uint8_t {
+	ShowSource,
+	HideSource,
+	ToggleSource,
+	ShowFilter,
+	HideFilter,
+	ToggleFilter,
+	SwitchScene,
+	// Explicit group markers: everything an origin sends between them is
+	// applied as one unit, even across lines.
+	BeginBatch,
+	CommitBatch,
+	// Never parsed: queued behind the last command of an origin whose input
+	// ended, so the tick can drop a group it left open.
+	EndOrigin,
+	Unknown,
+};
+
+constexpr size_t kEventTypeCount = static_cast<size_t>(EventType::Unknown);
+
+// EventCommand::flags
+enum EventCommandFlags : uint8_t {
+	// Last command of the event line it was parsed from.
+	kCommandEndsLine = 1 << 0,
+	// Last command of a unit staged by EventBatch; set on the tick only.
+	kCommandEndsUnit = 1 << 1,
+	// Queued in Lane::High; see lane_of().
+	kCommandHighPriority = 1 << 2,
+};
+
+// Priority class of a command. Every lane is its own queue and the tick
+// services Lane::High first, so a flood of cosmetic commands cannot hold up
+// the ones the audience notices. All commands of a line, and of a begin/commit
+// group, share one lane.
+enum class Lane : uint8_t {
+	Normal,
+	High,
+};
+
+constexpr size_t kLaneCount = 2;
+
+// The lane a command type goes to unless -priority says otherwise.
+constexpr Lane default_lane_of(const EventType type) noexcept
+{
+	return type == EventType::SwitchScene ? Lane::High : Lane::Normal;
+}
+
+// One ';'-separated command of an event line, parsed on the ingest thread.
+// Fixed size and trivially copyable so it can be queued as is; names are
+// interned handles (see NameTable.hpp). origin identifies the connection (or
+// other source, see acquire_message_origin()) it arrived on, so the tick can
+// reassemble lines and groups that were interleaved with other senders in the
+// channel. due_ns is the os_gettime_ns() time the command should be applied
+// at, or 0 to apply it as soon as possible; received_ns is when its line
+// arrived and was parsed by the listener, for latency accounting and expiry.
+// expires_ns is the sender's deadline (-ttl_ms), after which the command is
+// dropped unapplied, or 0 for none.
+struct EventCommand {
+	EventType type = EventType::Unknown;
+	uint8_t flags = 0;
+	uint16_t origin = 0;
+	NameId scene = kNoName;
+	NameId source = kNoName;
+	NameId filter = kNoName;
+	uint64_t due_ns = 0;
+	uint64_t received_ns = 0;
+	uint64_t expires_ns = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<EventCommand>);
+
+constexpr Lane lane_of(const EventCommand &command) noexcept
+{
+	return (command.flags & kCommandHighPriority) ? Lane::High : Lane::Normal;
+}
+
+constexpr const char *lane_name(const Lane lane) noexcept
+{
+	return lane == Lane::High ? "high" : "normal";
+}
+
+// Still inside one cache-line sized MpscRing slot, next to its sequence number.
+static_assert(sizeof(EventCommand) == 40);
+
+// What a command acts on, for coalescing.
+enum class TargetClass : uint8_t {
+	None,
+	SceneItem,
+	Filter,
+	ProgramScene,
+};
+
+constexpr TargetClass target_class_of(const EventType type) noexcept
+{
+	switch (type) {
+	case EventType::ShowSource:
+	case EventType::HideSource:
+	case EventType::ToggleSource:
+		return TargetClass::SceneItem;
+	case EventType::ShowFilter:
+	case EventType::HideFilter:
+	case EventType::ToggleFilter:
+		return TargetClass::Filter;
+	case EventType::SwitchScene:
+		return TargetClass::ProgramScene;
+	case EventType::BeginBatch:
+	case EventType::CommitBatch:
+	case EventType::EndOrigin:
+	case EventType::Unknown:
+		break;
+	}
+	return TargetClass::None;
+}
+
+// Two commands with the same target supersede each other.
+struct CommandTarget {
+	TargetClass target_class = TargetClass::None;
+	NameId scene = kNoName;
+	NameId source = kNoName;
+	NameId filter = kNoName;
+
+	bool operator==(const CommandTarget &other) const noexcept
+	{
+		return target_class == other.target_class && scene == other.scene &&
+		       source == other.source && filter == other.filter;
+	}
+};
+
+struct CommandTargetHash {
+	size_t operator()(const CommandTarget &target) const noexcept
+	{
+		uint64_t h = 0xcbf29ce484222325ull ^ static_cast<uint64_t>(target.target_class);
+		for (const NameId id : {target.scene, target.source, target.filter})
+			h = (h ^ id) * 0x100000001b3ull;
+		return static_cast<size_t>(h);
+	}
+};
+
+constexpr CommandTarget command_target(const EventCommand &command) noexcept
+{
+	const TargetClass target = target_class_of(command.type);
+	// Only one program scene; every switch supersedes the last.
+	if (target == TargetClass::ProgramScene || target == TargetClass::None)
+		return CommandTarget{target, kNoName, kNoName, kNoName};
+	return CommandTarget{target, command.scene, command.source, command.filter};
+}
@@ -0,0 +1,423 @@
+// IoUringListener.cpp
+#include "IoUringListener.hpp"
+#include "ListenerSockets.hpp"
+
+#include <obs-module.h>
+
+#include <liburing.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr unsigned kRingEntries = 256;
+
+// Kernel-provided receive buffers: the kernel picks a free buffer per
+// completion, so framing reads straight out of it and no recv() is issued.
+constexpr unsigned kStreamBufferCount = 256; // power of two
+constexpr unsigned kStreamBufferSize = 4096;
+constexpr unsigned kDatagramBufferCount = 16; // power of two
+constexpr unsigned kDatagramBufferSize = 65536;
+constexpr int kStreamBufferGroup = 0;
+constexpr int kDatagramBufferGroup = 1;
+
+enum class Op : uint32_t {
+    Wake,
+    Accept,
+    Recv,
+    RecvDatagram,
+};
+
+constexpr uint64_t encode(Op op, int fd) {
+    return (static_cast<uint64_t>(op) << 32) | static_cast<uint32_t>(fd);
+}
+
+constexpr Op op_of(uint64_t user_data) {
+    return static_cast<Op>(user_data >> 32);
+}
+
+constexpr int fd_of(uint64_t user_data) {
+    return static_cast<int>(static_cast<uint32_t>(user_data));
+}
+
+// Multishot recv landed in 6.0, provided buffer rings in 5.19.
+bool kernel_supports_multishot_recv() {
+    utsname info{};
+    if (uname(&info) != 0) return false;
+
+    int major = 0;
+    if (std::sscanf(info.release, "%d.", &major) != 1) return false;
+    return major >= 6;
+}
+
+struct BufferRing {
+    io_uring_buf_ring* ring = nullptr;
+    std::unique_ptr<char[]> storage;
+    unsigned count = 0;
+    unsigned size = 0;
+    int group = 0;
+
+    bool setup(io_uring* uring, unsigned buffer_count, unsigned buffer_size, int buffer_group) {
+        int ret = 0;
+        ring = io_uring_setup_buf_ring(uring, buffer_count, buffer_group, 0, &ret);
+        if (!ring) {
+            blog(LOG_WARNING, "[hot-cue-mesh] io_uring_setup_buf_ring() failed: %s", std::strerror(-ret));
+            return false;
+        }
+
+        storage = std::make_unique<char[]>(static_cast<size_t>(buffer_count) * buffer_size);
+        count = buffer_count;
+        size = buffer_size;
+        group = buffer_group;
+        for (unsigned bid = 0; bid < count; ++bid) {
+            io_uring_buf_ring_add(ring, data(bid), size, static_cast<unsigned short>(bid),
+                                  io_uring_buf_ring_mask(count), static_cast<int>(bid));
+        }
+        io_uring_buf_ring_advance(ring, static_cast<int>(count));
+        return true;
+    }
+
+    void release(io_uring* uring) {
+        if (ring) io_uring_free_buf_ring(uring, ring, count, group);
+        ring = nullptr;
+    }
+
+    char* data(unsigned bid) const { return storage.get() + static_cast<size_t>(bid) * size; }
+
+    // Hands a consumed buffer back to the kernel.
+    void recycle(unsigned bid) {
+        io_uring_buf_ring_add(ring, data(bid), size, static_cast<unsigned short>(bid),
+                              io_uring_buf_ring_mask(count), 0);
+        io_uring_buf_ring_advance(ring, 1);
+    }
+};
+
+struct Connection {
+    LineAssembler lines;
+    // The End for its origin went out already; whatever else the recv still
+    // completes with is dropped.
+    bool finished = false;
+};
+
+class IoUringReactor {
+public:
+    explicit IoUringReactor(LineSink sink) : sink_(std::move(sink)) {}
+
+    ~IoUringReactor() {
+        if (ring_ready_) {
+            stream_buffers_.release(&ring_);
+            datagram_buffers_.release(&ring_);
+            // Cancels every in-flight multishot request.
+            io_uring_queue_exit(&ring_);
+        }
+        for (auto& entry : connections_) {
+            close(entry.first);
+        }
+        if (tcp_fd_ >= 0) close(tcp_fd_);
+        if (unix_fd_ >= 0) {
+            close(unix_fd_);
+            unlink(unix_path_.c_str());
+        }
+        if (udp_fd_ >= 0) close(udp_fd_);
+        release_message_origin(datagram_origin_);
+        if (wake_fd_ >= 0) close(wake_fd_);
+    }
+
+    bool open(const ListenerOptions& options) {
+        if (!kernel_supports_multishot_recv()) {
+            blog(LOG_WARNING, "[hot-cue-mesh] kernel too old for io_uring multishot recv");
+            return false;
+        }
+
+        const int ret = io_uring_queue_init(kRingEntries, &ring_, 0);
+        if (ret < 0) {
+            blog(LOG_WARNING, "[hot-cue-mesh] io_uring_queue_init() failed: %s", std::strerror(-ret));
+            return false;
+        }
+        ring_ready_ = true;
+
+        if (!stream_buffers_.setup(&ring_, kStreamBufferCount, kStreamBufferSize, kStreamBufferGroup)) {
+            return false;
+        }
+
+        wake_fd_ = eventfd(0, EFD_CLOEXEC);
+        if (wake_fd_ < 0) {
+            blog(LOG_ERROR, "[hot-cue-mesh] eventfd() failed: %s", std::strerror(errno));
+            return false;
+        }
+        io_uring_sqe* sqe = get_sqe();
+        io_uring_prep_read(sqe, wake_fd_, &wake_value_, sizeof(wake_value_), 0);
+        io_uring_sqe_set_data64(sqe, encode(Op::Wake, wake_fd_));
+
+        if (options.tcp_port != 0) {
+            tcp_fd_ = open_tcp_listener(options.tcp_port);
+            if (tcp_fd_ >= 0) {
+                arm(tcp_fd_, Op::Accept);
+                blog(LOG_INFO, "[hot-cue-mesh] listening for hot cue events on 127.0.0.1:%u (io_uring)",
+                     options.tcp_port);
+            }
+        }
+        if (!options.unix_path.empty()) {
+            unix_fd_ = open_unix_listener(options.unix_path);
+            if (unix_fd_ >= 0) {
+                unix_path_ = options.unix_path;
+                arm(unix_fd_, Op::Accept);
+                blog(LOG_INFO, "[hot-cue-mesh] listening for hot cue events on %s (io_uring)",
+                     options.unix_path.c_str());
+            }
+        }
+        if (options.udp_port != 0 &&
+            datagram_buffers_.setup(&ring_, kDatagramBufferCount, kDatagramBufferSize, kDatagramBufferGroup)) {
+            udp_fd_ = open_udp_socket(options.udp_port);
+            if (udp_fd_ >= 0) {
+                datagram_origin_ = acquire_message_origin();
+                arm(udp_fd_, Op::RecvDatagram);
+                blog(LOG_INFO, "[hot-cue-mesh] listening for hot cue datagrams on udp 127.0.0.1:%u (io_uring)",
+                     options.udp_port);
+            }
+        }
+
+        if (tcp_fd_ < 0 && unix_fd_ < 0 && udp_fd_ < 0) {
+            return false;
+        }
+        return io_uring_submit(&ring_) >= 0;
+    }
+
+    void run() {
+        while (!stopping_) {
+            ++syscalls_;
+            const int ret = io_uring_submit_and_wait(&ring_, 1);
+            if (ret < 0) {
+                if (ret == -EINTR) continue;
+                blog(LOG_ERROR, "[hot-cue-mesh] io_uring_submit_and_wait() failed: %s", std::strerror(-ret));
+                break;
+            }
+
+            unsigned head = 0;
+            unsigned seen = 0;
+            io_uring_cqe* cqe = nullptr;
+            io_uring_for_each_cqe(&ring_, head, cqe) {
+                ++seen;
+                if (!stopping_) {
+                    handle(*cqe);
+                }
+            }
+            io_uring_cq_advance(&ring_, seen);
+            // Every buffer of the batch is back with the kernel now.
+            rearm_deferred();
+        }
+
+        blog(LOG_INFO, "[hot-cue-mesh] io_uring listener: %llu lines, %llu frames, %llu syscalls",
+             static_cast<unsigned long long>(lines_), static_cast<unsigned long long>(frames_),
+             static_cast<unsigned long long>(syscalls_));
+    }
+
+    void wake() {
+        const uint64_t one = 1;
+        [[maybe_unused]] const ssize_t written = write(wake_fd_, &one, sizeof(one));
+    }
+
+private:
+    io_uring_sqe* get_sqe() {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+        if (!sqe) {
+            // Submission queue full: flush it and retry once.
+            ++syscalls_;
+            io_uring_submit(&ring_);
+            sqe = io_uring_get_sqe(&ring_);
+        }
+        return sqe;
+    }
+
+    // Arms a multishot accept or recv on fd. If there is no room for it even
+    // after a flush, it is retried after the next batch of completions, so
+    // the socket is never left without a request.
+    void arm(int fd, Op op) {
+        io_uring_sqe* sqe = get_sqe();
+        if (!sqe) {
+            blog(LOG_WARNING, "[hot-cue-mesh] io_uring submission queue full; re-arming fd %d later", fd);
+            deferred_.push_back({fd, op});
+            return;
+        }
+        if (op == Op::Accept) {
+            io_uring_prep_multishot_accept(sqe, fd, nullptr, nullptr, SOCK_CLOEXEC);
+        } else {
+            io_uring_prep_recv_multishot(sqe, fd, nullptr, 0, 0);
+            sqe->flags |= IOSQE_BUFFER_SELECT;
+            sqe->buf_group = static_cast<uint16_t>(op == Op::Recv ? kStreamBufferGroup : kDatagramBufferGroup);
+        }
+        io_uring_sqe_set_data64(sqe, encode(op, fd));
+    }
+
+    void rearm_deferred() {
+        if (deferred_.empty()) return;
+        std::vector<DeferredArm> arms;
+        arms.swap(deferred_);
+        for (const DeferredArm& entry : arms) {
+            // A connection may have been dropped in the meantime.
+            if (entry.op == Op::Recv && connections_.count(entry.fd) == 0) continue;
+            arm(entry.fd, entry.op);
+        }
+    }
+
+    bool deliver(EventMessage message, MessageFormat format, uint16_t origin) {
+        if (format != MessageFormat::End) ++(format == MessageFormat::Frame ? frames_ : lines_);
+        return sink_(std::move(message), format, origin);
+    }
+
+    void handle(const io_uring_cqe& cqe) {
+        const uint64_t user_data = io_uring_cqe_get_data64(&cqe);
+        const int fd = fd_of(user_data);
+        const bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+
+        switch (op_of(user_data)) {
+        case Op::Wake:
+            stopping_ = true;
+            return;
+
+        case Op::Accept:
+            if (cqe.res >= 0) {
+                connections_.try_emplace(cqe.res);
+                arm(cqe.res, Op::Recv);
+            } else if (cqe.res != -EINTR && cqe.res != -ECONNABORTED) {
+                blog(LOG_WARNING, "[hot-cue-mesh] accept failed: %s", std::strerror(-cqe.res));
+            }
+            if (!more) arm(fd, Op::Accept);
+            return;
+
+        case Op::Recv:
+            handle_stream(cqe, fd, more);
+            return;
+
+        case Op::RecvDatagram:
+            if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER)) {
+                const unsigned bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+                if (!deliver_datagram(datagram_buffers_.data(bid), static_cast<size_t>(cqe.res), datagram_origin_,
+                                      deliver_, datagram_writer_, datagram_scratch_)) {
+                    stopping_ = true;
+                }
+                datagram_buffers_.recycle(bid);
+            }
+            // Not before the batch is done: on ENOBUFS the buffers are only
+            // handed back further down it.
+            if (!more) deferred_.push_back({fd, Op::RecvDatagram});
+            return;
+        }
+    }
+
+    void handle_stream(const io_uring_cqe& cqe, int fd, bool more) {
+        auto it = connections_.find(fd);
+        if (it == connections_.end()) return;
+
+        Connection& connection = it->second;
+
+        if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER)) {
+            const unsigned bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+            // One copy per completion into the connection's slab, none per line.
+            const bool keep_going =
+                connection.finished ||
+                connection.lines.append(stream_buffers_.data(bid), static_cast<size_t>(cqe.res), deliver_);
+            stream_buffers_.recycle(bid);
+            if (!keep_going) {
+                stopping_ = true;
+                return;
+            }
+            if (!more && !connection.finished) arm(fd, Op::Recv);
+        } else if (cqe.res == -ENOBUFS && !connection.finished) {
+            // Every buffer was in flight. Re-armed once the rest of the batch,
+            // which holds them, has been recycled; right away it would only
+            // fail again.
+            if (!more) deferred_.push_back({fd, Op::Recv});
+            return;
+        } else if (!connection.finished) {
+            // EOF or hard error: flush the client, once.
+            connection.finished = true;
+            if (!connection.lines.finish(deliver_)) {
+                stopping_ = true;
+            }
+        }
+
+        // Dropped with the last completion of its recv.
+        if (!more && connection.finished) {
+            close(fd);
+            connections_.erase(it);
+        }
+    }
+
+    struct DeferredArm {
+        int fd;
+        Op op;
+    };
+
+    LineSink sink_;
+    const LineSink deliver_ = [this](EventMessage message, MessageFormat format, uint16_t origin) {
+        return deliver(std::move(message), format, origin);
+    };
+    io_uring ring_{};
+    bool ring_ready_ = false;
+    BufferRing stream_buffers_;
+    BufferRing datagram_buffers_;
+    int wake_fd_ = -1;
+    uint64_t wake_value_ = 0;
+    int tcp_fd_ = -1;
+    int unix_fd_ = -1;
+    std::string unix_path_;
+    int udp_fd_ = -1;
+    SlabWriter datagram_writer_;
+    std::string datagram_scratch_;
+    uint16_t datagram_origin_ = 0;
+    bool stopping_ = false;
+    uint64_t lines_ = 0;
+    uint64_t frames_ = 0;
+    uint64_t syscalls_ = 0;
+    std::unordered_map<int, Connection> connections_;
+    // Requests to arm after the current batch of completions.
+    std::vector<DeferredArm> deferred_;
+};
+
+std::mutex g_mu;
+std::unique_ptr<IoUringReactor> g_reactor;
+std::unique_ptr<std::thread> g_thr;
+} // namespace
+
+bool start_io_uring_listener(const ListenerOptions& options, LineSink sink) {
+    std::lock_guard<std::mutex> lk(g_mu);
+    if (g_reactor) return true;
+
+    auto reactor = std::make_unique<IoUringReactor>(std::move(sink));
+    if (!reactor->open(options)) {
+        return false;
+    }
+
+    g_reactor = std::move(reactor);
+    g_thr = std::make_unique<std::thread>([reactor = g_reactor.get()]() {
+        reactor->run();
+    });
+    return true;
+}
+
+void stop_io_uring_listener() {
+    std::unique_ptr<std::thread> thr;
+    std::unique_ptr<IoUringReactor> reactor;
+
+    {
+        std::lock_guard<std::mutex> lk(g_mu);
+        thr = std::move(g_thr);
+        reactor = std::move(g_reactor);
+    }
+
+    if (reactor) reactor->wake();
+    if (thr && thr->joinable()) thr->join();
+}
@@ -0,0 +1,9 @@
+// IoUringListener.hpp
+#pragma once
+
+#include "Listener.hpp"
+
+// io_uring backend of start_event_listener(); use that instead. Returns false
+// if the kernel or liburing lacks multishot recv / provided buffer rings.
+bool start_io_uring_listener(const ListenerOptions& options, LineSink sink);
+void stop_io_uring_listener();
@@ -0,0 +1,100 @@
+// JsonWriter.hpp
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Appends compact JSON to a string, without building a document first. The
+// output matches nlohmann::json::dump() for the same values: no whitespace,
+// and strings escaped the same way (UTF-8 passed through, control characters
+// as \b \t \n \f \r or \u00xx). Keys are written in the order given; callers
+// that must match dump() write them sorted.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out_(out) {}
+
+    void begin_object() { open('{'); }
+    void end_object() { close('}'); }
+    void begin_array() { open('['); }
+    void end_array() { close(']'); }
+
+    void key(std::string_view name) {
+        separate();
+        write_string(name);
+        out_ += ':';
+        first_ = true; // the value that follows needs no comma
+    }
+
+    void string_value(std::string_view value) {
+        separate();
+        write_string(value);
+    }
+
+    void bool_value(bool value) {
+        separate();
+        out_ += value ? "true" : "false";
+    }
+
+    void uint_value(uint64_t value) {
+        separate();
+        char digits[20];
+        size_t n = 0;
+        do {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        while (n > 0) out_ += digits[--n];
+    }
+
+private:
+    void separate() {
+        if (!first_) out_ += ',';
+        first_ = false;
+    }
+
+    void open(char bracket) {
+        separate();
+        out_ += bracket;
+        first_ = true;
+    }
+
+    void close(char bracket) {
+        out_ += bracket;
+        first_ = false;
+    }
+
+    void write_string(std::string_view value) {
+        static constexpr char kHex[] = "0123456789abcdef";
+        out_ += '"';
+        size_t run = 0; // start of the bytes not yet copied
+        for (size_t i = 0; i < value.size(); ++i) {
+            const auto c = static_cast<unsigned char>(value[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+            out_.append(value.data() + run, i - run);
+            run = i + 1;
+            out_ += '\\';
+            switch (c) {
+            case '"': out_ += '"'; break;
+            case '\\': out_ += '\\'; break;
+            case '\b': out_ += 'b'; break;
+            case '\t': out_ += 't'; break;
+            case '\n': out_ += 'n'; break;
+            case '\f': out_ += 'f'; break;
+            case '\r': out_ += 'r'; break;
+            default:
+                out_ += "u00";
+                out_ += kHex[c >> 4];
+                out_ += kHex[c & 0xf];
+                break;
+            }
+        }
+        out_.append(value.data() + run, value.size() - run);
+        out_ += '"';
+    }
+
+    std::string& out_;
+    // At the start of a container (or right after a key).
+    bool first_ = true;
+};
@@ -0,0 +1,49 @@
+// LatencyHistogram.cpp
+#include "LatencyHistogram.hpp"
+
+size_t LatencyHistogram::bucket_of(uint64_t us) noexcept {
+    if (us < kSubBuckets) return static_cast<size_t>(us);
+    if (us >= (uint64_t{1} << kMaxExponent)) us = (uint64_t{1} << kMaxExponent) - 1;
+
+    size_t exponent = kSubBits;
+    while ((us >> (exponent + 1)) != 0) ++exponent;
+    const size_t sub = static_cast<size_t>(us >> (exponent - kSubBits)) & (kSubBuckets - 1);
+    return (exponent - kSubBits + 1) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucket_upper_us(size_t bucket) noexcept {
+    if (bucket < kSubBuckets) return bucket;
+
+    const size_t exponent = bucket / kSubBuckets + kSubBits - 1;
+    const uint64_t sub = bucket % kSubBuckets;
+    const uint64_t width = uint64_t{1} << (exponent - kSubBits);
+    return ((kSubBuckets + sub) << (exponent - kSubBits)) + width - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns) noexcept {
+    buckets_[bucket_of(ns / 1000)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t seen = max_ns_.load(std::memory_order_relaxed);
+    while (ns > seen && !max_ns_.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::quantile_ns(double q) const noexcept {
+    const uint64_t total = count();
+    if (total == 0) return 0;
+
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total) + 0.5);
+    if (rank == 0) rank = 1;
+    if (rank > total) rank = total;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            const uint64_t upper = (bucket_upper_us(i) + 1) * 1000 - 1;
+            return upper < max_ns() ? upper : max_ns();
+        }
+    }
+    return max_ns();
+}
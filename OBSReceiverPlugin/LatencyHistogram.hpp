@@ -0,0 +1,35 @@
+// LatencyHistogram.hpp
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear histogram of durations: microsecond resolution below 8 us, then
+// eight buckets per power of two (at most 12.5% error) up to about 70
+// minutes. Recording is a few relaxed atomic adds, safe from any thread.
+class LatencyHistogram {
+public:
+    void record(uint64_t ns) noexcept;
+
+    uint64_t count() const noexcept { return count_.load(std::memory_order_relaxed); }
+    uint64_t max_ns() const noexcept { return max_ns_.load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the q-quantile (0 < q <= 1), capped
+    // at max_ns(); 0 if nothing was recorded.
+    uint64_t quantile_ns(double q) const noexcept;
+
+private:
+    static constexpr size_t kSubBits = 3;
+    static constexpr size_t kSubBuckets = size_t{1} << kSubBits;
+    static constexpr size_t kMaxExponent = 32;
+    static constexpr size_t kBuckets = (kMaxExponent - kSubBits + 2) * kSubBuckets;
+
+    static size_t bucket_of(uint64_t us) noexcept;
+    static uint64_t bucket_upper_us(size_t bucket) noexcept;
+
+    std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> max_ns_{0};
+};
@@ -0,0 +1,373 @@
+// LineFraming.cpp
+#include "LineFraming.hpp"
+#include "BinaryFraming.hpp"
+#include "Osc.hpp"
+
+#include <obs-module.h>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define HOT_CUE_MESH_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HOT_CUE_MESH_AVX2 1
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+// A partial line is carried into a fresh slab once less than this is free.
+constexpr size_t kMinReceiveSpace = 1024;
+
+inline unsigned lowest_set_bit(uint32_t mask) noexcept {
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+const char* find_newline_scalar(const char* begin, const char* end) noexcept {
+    const void* hit = std::memchr(begin, '\n', static_cast<size_t>(end - begin));
+    return hit ? static_cast<const char*>(hit) : end;
+}
+
+#ifdef HOT_CUE_MESH_SSE2
+const char* find_newline_sse2(const char* p, const char* end) noexcept {
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; end - p >= 16; p += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+        if (mask != 0) return p + lowest_set_bit(mask);
+    }
+    return find_newline_scalar(p, end);
+}
+#endif
+
+#ifdef HOT_CUE_MESH_AVX2
+__attribute__((target("avx2"))) const char* find_newline_avx2(const char* p, const char* end) noexcept {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    for (; end - p >= 32; p += 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)));
+        if (mask != 0) return p + lowest_set_bit(mask);
+    }
+    return find_newline_sse2(p, end);
+}
+#endif
+
+using FindNewlineFn = const char* (*)(const char*, const char*) noexcept;
+
+FindNewlineFn select_find_newline() noexcept {
+#ifdef HOT_CUE_MESH_AVX2
+    if (__builtin_cpu_supports("avx2")) return find_newline_avx2;
+#endif
+#ifdef HOT_CUE_MESH_SSE2
+    return find_newline_sse2;
+#else
+    return find_newline_scalar;
+#endif
+}
+
+const FindNewlineFn g_find_newline = select_find_newline();
+
+std::mutex g_origin_mutex;
+// Origins never handed out start here; 0 once all of them have been.
+uint16_t g_next_origin = 1;
+std::vector<uint16_t> g_free_origins;
+
+} // namespace
+
+uint16_t acquire_message_origin() {
+    std::lock_guard<std::mutex> lock(g_origin_mutex);
+    if (!g_free_origins.empty()) {
+        const uint16_t origin = g_free_origins.back();
+        g_free_origins.pop_back();
+        return origin;
+    }
+    const uint16_t origin = g_next_origin;
+    if (origin != 0) ++g_next_origin;
+    return origin;
+}
+
+void release_message_origin(uint16_t origin) {
+    if (origin == 0) return;
+    std::lock_guard<std::mutex> lock(g_origin_mutex);
+    g_free_origins.push_back(origin);
+}
+
+const char* find_newline(const char* begin, const char* end) noexcept {
+    return g_find_newline(begin, end);
+}
+
+LineAssembler::LineAssembler() : origin_(acquire_message_origin()) {}
+
+LineAssembler::LineAssembler(LineAssembler&& other) noexcept
+    : slab_(other.slab_), line_start_(other.line_start_), end_(other.end_), discarding_(other.discarding_),
+      framing_(other.framing_), skipping_(other.skipping_), origin_(other.origin_) {
+    other.slab_ = nullptr;
+    other.line_start_ = 0;
+    other.end_ = 0;
+    other.discarding_ = false;
+    other.framing_ = Framing::Unknown;
+    other.skipping_ = 0;
+    other.origin_ = 0;
+}
+
+LineAssembler& LineAssembler::operator=(LineAssembler&& other) noexcept {
+    if (this != &other) {
+        if (slab_) release_message_slab(slab_);
+        release_message_origin(origin_);
+        slab_ = other.slab_;
+        line_start_ = other.line_start_;
+        end_ = other.end_;
+        discarding_ = other.discarding_;
+        framing_ = other.framing_;
+        skipping_ = other.skipping_;
+        origin_ = other.origin_;
+        other.slab_ = nullptr;
+        other.line_start_ = 0;
+        other.end_ = 0;
+        other.discarding_ = false;
+        other.framing_ = Framing::Unknown;
+        other.skipping_ = 0;
+        other.origin_ = 0;
+    }
+    return *this;
+}
+
+LineAssembler::~LineAssembler() {
+    if (slab_) release_message_slab(slab_);
+    release_message_origin(origin_);
+}
+
+std::pair<char*, size_t> LineAssembler::receive_area() {
+    if (!slab_ || kMessageSlabSize - end_ < kMinReceiveSpace) {
+        roll_over();
+    }
+    return {slab_->data + end_, kMessageSlabSize - end_};
+}
+
+void LineAssembler::roll_over() {
+    MessageSlab* next = acquire_message_slab();
+    uint32_t carried = 0;
+    if (slab_) {
+        carried = end_ - line_start_;
+        if (carried > kMessageSlabSize - kMinReceiveSpace) {
+            // The partial line alone nearly fills a slab; give up on it.
+            blog(LOG_WARNING, "[hot-cue-mesh] dropping event line longer than %zu bytes",
+                 kMessageSlabSize - kMinReceiveSpace);
+            discarding_ = true;
+            carried = 0;
+        } else if (carried > 0) {
+            std::memcpy(next->data, slab_->data + line_start_, carried);
+        }
+        release_message_slab(slab_);
+    }
+
+    slab_ = next;
+    line_start_ = 0;
+    end_ = carried;
+}
+
+bool LineAssembler::commit(size_t size, const LineSink& sink) {
+    const uint32_t scan_from = end_;
+    end_ += static_cast<uint32_t>(size);
+
+    if (framing_ == Framing::Unknown && end_ > line_start_) {
+        // The first byte picks the framing for the whole connection.
+        if (static_cast<uint8_t>(slab_->data[line_start_]) == kBinaryFramingMagic) {
+            framing_ = Framing::Frames;
+            ++line_start_;
+        } else {
+            framing_ = Framing::Lines;
+        }
+    }
+
+    switch (framing_) {
+    case Framing::Lines:
+        return commit_lines(scan_from, sink);
+    case Framing::Frames:
+        return commit_frames(sink);
+    case Framing::Unknown:
+    case Framing::Broken:
+        break;
+    }
+    line_start_ = end_;
+    return true;
+}
+
+bool LineAssembler::commit_lines(uint32_t scan_from, const LineSink& sink) {
+    const char* base = slab_->data;
+    const char* cursor = base + scan_from;
+    const char* const stop = base + end_;
+    while (true) {
+        const char* newline = find_newline(cursor, stop);
+        if (newline == stop) break;
+
+        const uint32_t line_end = static_cast<uint32_t>(newline - base);
+        if (discarding_) {
+            discarding_ = false;
+        } else if (!publish(line_start_, line_end, sink)) {
+            line_start_ = line_end + 1;
+            return false;
+        }
+        line_start_ = line_end + 1;
+        cursor = newline + 1;
+    }
+
+    if (discarding_) {
+        // Nothing worth keeping until the next newline.
+        line_start_ = end_;
+    }
+    return true;
+}
+
+bool LineAssembler::commit_frames(const LineSink& sink) {
+    const auto* base = reinterpret_cast<const uint8_t*>(slab_->data);
+    while (line_start_ < end_) {
+        if (skipping_ > 0) {
+            const uint32_t skipped = static_cast<uint32_t>(std::min<uint64_t>(skipping_, end_ - line_start_));
+            line_start_ += skipped;
+            skipping_ -= skipped;
+            continue;
+        }
+
+        uint64_t length = 0;
+        size_t header = 0;
+        const VarintResult result = read_varint(base + line_start_, end_ - line_start_, length, header);
+        if (result == VarintResult::Incomplete) break;
+        if (result == VarintResult::Malformed) {
+            blog(LOG_WARNING, "[hot-cue-mesh] malformed binary frame length, ignoring the rest of the connection");
+            framing_ = Framing::Broken;
+            line_start_ = end_;
+            break;
+        }
+        if (length > kMaxFrameSize) {
+            blog(LOG_WARNING, "[hot-cue-mesh] dropping binary frame longer than %zu bytes", kMaxFrameSize);
+            line_start_ += static_cast<uint32_t>(header);
+            skipping_ = length;
+            continue;
+        }
+        if (end_ - line_start_ - header < length) break;
+
+        const uint32_t begin = line_start_ + static_cast<uint32_t>(header);
+        line_start_ = begin + static_cast<uint32_t>(length);
+        if (length > 0 && !sink(EventMessage(slab_, begin, static_cast<uint32_t>(length)), MessageFormat::Frame, origin_)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LineAssembler::append(const char* data, size_t size, const LineSink& sink) {
+    while (size > 0) {
+        const auto [area, space] = receive_area();
+        const size_t chunk = size < space ? size : space;
+        std::memcpy(area, data, chunk);
+        if (!commit(chunk, sink)) return false;
+        data += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool LineAssembler::finish(const LineSink& sink) {
+    if (framing_ == Framing::Frames && (line_start_ != end_ || skipping_ > 0)) {
+        blog(LOG_WARNING, "[hot-cue-mesh] connection closed inside a binary frame, dropping it");
+    }
+    if (slab_ && framing_ == Framing::Lines && !discarding_ && line_start_ != end_) {
+        const uint32_t begin = line_start_;
+        line_start_ = end_;
+        if (!publish(begin, end_, sink)) return false;
+    }
+    line_start_ = end_;
+    discarding_ = false;
+    return sink(EventMessage(), MessageFormat::End, origin_);
+}
+
+bool LineAssembler::publish(uint32_t begin, uint32_t end, const LineSink& sink) {
+    if (end > begin && slab_->data[end - 1] == '\r') --end;
+    if (end == begin) return true;
+    return sink(EventMessage(slab_, begin, end - begin), MessageFormat::Line, origin_);
+}
+
+namespace {
+
+bool deliver_datagram_messages(const char* data, size_t size, const LineSink& sink, SlabWriter& writer,
+                               std::string& scratch, uint16_t origin) {
+    bool keep_going = true;
+    const auto write = [&](std::string_view bytes, MessageFormat format) {
+        EventMessage message = writer.write(bytes);
+        if (message.empty()) {
+            blog(LOG_WARNING, "[hot-cue-mesh] dropping event line longer than %zu bytes", kMessageSlabSize);
+            return true;
+        }
+        keep_going = sink(std::move(message), format, origin);
+        return keep_going;
+    };
+    const auto emit = [&](std::string_view line) {
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) return true;
+        return write(line, MessageFormat::Line);
+    };
+
+    if (size > 0 && static_cast<uint8_t>(data[0]) == kBinaryFramingMagic) {
+        const auto* cursor = reinterpret_cast<const uint8_t*>(data) + 1;
+        const auto* const end = reinterpret_cast<const uint8_t*>(data) + size;
+        while (cursor < end && keep_going) {
+            uint64_t length = 0;
+            size_t header = 0;
+            if (read_varint(cursor, static_cast<size_t>(end - cursor), length, header) != VarintResult::Ok ||
+                length > static_cast<size_t>(end - cursor) - header) {
+                blog(LOG_WARNING, "[hot-cue-mesh] dropping malformed binary datagram (%zu bytes)", size);
+                break;
+            }
+            cursor += header;
+            if (length > kMaxFrameSize) {
+                blog(LOG_WARNING, "[hot-cue-mesh] dropping binary frame longer than %zu bytes", kMaxFrameSize);
+            } else if (length > 0) {
+                write(std::string_view(reinterpret_cast<const char*>(cursor), static_cast<size_t>(length)),
+                      MessageFormat::Frame);
+            }
+            cursor += length;
+        }
+        return keep_going;
+    }
+
+    if (size > 0 && (data[0] == '/' || data[0] == '#')) {
+        if (!decode_osc_packet(data, size, scratch, emit)) {
+            blog(LOG_WARNING, "[hot-cue-mesh] dropping malformed OSC datagram (%zu bytes)", size);
+        }
+        return keep_going;
+    }
+
+    // Every datagram is self-contained, so a trailing line needs no terminator.
+    const char* cursor = data;
+    const char* const end = data + size;
+    while (cursor < end && keep_going) {
+        const char* newline = find_newline(cursor, end);
+        emit(std::string_view(cursor, static_cast<size_t>(newline - cursor)));
+        cursor = newline + 1;
+    }
+    return keep_going;
+}
+
+} // namespace
+
+bool deliver_datagram(const char* data, size_t size, uint16_t origin, const LineSink& sink, SlabWriter& writer,
+                      std::string& scratch) {
+    return deliver_datagram_messages(data, size, sink, writer, scratch, origin) &&
+           sink(EventMessage(), MessageFormat::End, origin);
+}
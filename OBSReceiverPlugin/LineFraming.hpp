@@ -0,0 +1,102 @@
+// LineFraming.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "MessageSlab.hpp"
+
+// What an EventMessage holds: an event line, or the payload of a binary frame
+// (see BinaryFraming.hpp). End carries no message: its origin is done, and
+// nothing more will come from it.
+enum class MessageFormat : uint8_t {
+    Line,
+    Frame,
+    End,
+};
+
+// Where a message came from: one stream connection, one datagram socket, or
+// the shared memory ring. Lines and begin/commit groups never span origins, so
+// the tick can pull apart the ones that were interleaved in the channel. An
+// origin is reused only once released, and its last End is queued by then.
+// Returns 0, shared by everyone, once all 65535 are taken. Thread-safe.
+uint16_t acquire_message_origin();
+void release_message_origin(uint16_t origin);
+
+// Receives every complete line or frame on the listener thread, tagged with
+// its origin. Returning false stops the listener (e.g. because the channel it
+// feeds was closed).
+using LineSink = std::function<bool(EventMessage message, MessageFormat format, uint16_t origin)>;
+
+// First '\n' in [begin, end), or end. SSE2/AVX2 when available.
+const char* find_newline(const char* begin, const char* end) noexcept;
+
+// Newline framing for one stream connection. Bytes are received straight into
+// a message slab; complete lines are published as views into it (dropping a
+// trailing '\r' and empty lines) and only a partial line is ever copied, when
+// it is carried over into a fresh slab. Lines longer than a slab are dropped.
+//
+// A connection whose first byte is kBinaryFramingMagic is split into
+// length-prefixed binary frames instead, published the same way. Frames longer
+// than kMaxFrameSize are skipped; a malformed length ends the connection's
+// input, since there is no way to find the next frame.
+//
+// Every assembler holds an origin of its own (see acquire_message_origin()).
+class LineAssembler {
+public:
+    LineAssembler();
+    LineAssembler(const LineAssembler&) = delete;
+    LineAssembler& operator=(const LineAssembler&) = delete;
+    LineAssembler(LineAssembler&& other) noexcept;
+    LineAssembler& operator=(LineAssembler&& other) noexcept;
+    ~LineAssembler();
+
+    // Free space to recv() into; never empty.
+    std::pair<char*, size_t> receive_area();
+
+    // Accounts for size bytes written into receive_area() and publishes every
+    // line they complete. Returns false if sink asked to stop.
+    bool commit(size_t size, const LineSink& sink);
+
+    // Copying variant for bytes that arrived elsewhere (kernel buffers).
+    bool append(const char* data, size_t size, const LineSink& sink);
+
+    // Call once the stream ended: delivers a trailing unterminated line, then
+    // MessageFormat::End. A trailing partial frame is dropped.
+    bool finish(const LineSink& sink);
+
+    uint16_t origin() const { return origin_; }
+
+private:
+    enum class Framing : uint8_t {
+        Unknown, // nothing received yet
+        Lines,
+        Frames,
+        Broken, // malformed frame length; the rest is ignored
+    };
+
+    bool commit_lines(uint32_t scan_from, const LineSink& sink);
+    bool commit_frames(const LineSink& sink);
+    bool publish(uint32_t begin, uint32_t end, const LineSink& sink);
+    void roll_over();
+
+    MessageSlab* slab_ = nullptr;
+    uint32_t line_start_ = 0; // start of the current partial line or frame
+    uint32_t end_ = 0;        // bytes received into slab_
+    bool discarding_ = false; // inside an over-long line, skip to its '\n'
+    Framing framing_ = Framing::Unknown;
+    uint64_t skipping_ = 0;   // bytes left of an over-long frame
+    uint16_t origin_ = 0;
+};
+
+// Datagram transports: an OSC packet (see Osc.hpp), binary frames after
+// kBinaryFramingMagic, or one or more newline-separated lines, copied into
+// slabs by writer and tagged with origin, the socket's. There is no connection
+// to close a group, so every datagram ends with MessageFormat::End; a group
+// must begin and commit within one datagram. Returns false if sink asked to
+// stop.
+bool deliver_datagram(const char* data, size_t size, uint16_t origin, const LineSink& sink, SlabWriter& writer,
+                      std::string& scratch);
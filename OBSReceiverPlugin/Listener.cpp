@@ -0,0 +1,44 @@
+// Listener.cpp
+#include "Listener.hpp"
+#include "EpollListener.hpp"
+#ifdef HOT_CUE_MESH_HAVE_IO_URING
+#include "IoUringListener.hpp"
+#endif
+
+#include <obs-module.h>
+
+const char* listener_backend_name(ListenerBackend backend) {
+    switch (backend) {
+    case ListenerBackend::Epoll: return "epoll";
+    case ListenerBackend::IoUring: return "io_uring";
+    }
+    return "unknown";
+}
+
+bool parse_listener_backend(const std::string& text, ListenerBackend& out) {
+    if (text == "epoll") out = ListenerBackend::Epoll;
+    else if (text == "io_uring") out = ListenerBackend::IoUring;
+    else return false;
+    return true;
+}
+
+bool start_event_listener(const ListenerOptions& options, LineSink sink) {
+    if (options.backend == ListenerBackend::IoUring) {
+#ifdef HOT_CUE_MESH_HAVE_IO_URING
+        if (start_io_uring_listener(options, sink)) {
+            return true;
+        }
+        blog(LOG_WARNING, "[hot-cue-mesh] io_uring listener unavailable, falling back to epoll");
+#else
+        blog(LOG_WARNING, "[hot-cue-mesh] built without liburing, falling back to epoll");
+#endif
+    }
+    return start_epoll_listener(options, std::move(sink));
+}
+
+void stop_event_listener() {
+#ifdef HOT_CUE_MESH_HAVE_IO_URING
+    stop_io_uring_listener();
+#endif
+    stop_epoll_listener();
+}
@@ -0,0 +1,35 @@
+// Listener.hpp
+#pragma once
+
+#include <string>
+
+#include "LineFraming.hpp"
+
+enum class ListenerBackend {
+    Epoll,
+    IoUring, // multishot accept/recv with provided buffer rings; needs liburing
+};
+
+const char* listener_backend_name(ListenerBackend backend);
+bool parse_listener_backend(const std::string& text, ListenerBackend& out);
+
+struct ListenerOptions {
+    ListenerBackend backend = ListenerBackend::Epoll;
+    // TCP on 127.0.0.1; 0 disables it.
+    unsigned short tcp_port = 0;
+    // AF_UNIX stream socket for same-host senders; empty disables it. A stale
+    // socket file at this path is replaced.
+    std::string unix_path;
+    // UDP on 127.0.0.1; 0 disables it. Each datagram carries one or more
+    // newline-separated event lines, or an OSC packet (see Osc.hpp).
+    unsigned short udp_port = 0;
+};
+
+// Serves any number of concurrent senders on every enabled socket from one
+// reactor thread, using the same newline framing as the Windows listener.
+// Falls back to epoll if the requested backend is unavailable. Returns false
+// if no socket could be set up. Linux only.
+bool start_event_listener(const ListenerOptions& options, LineSink sink);
+
+// Wakes the reactor through its eventfd and joins it; no timeout polling.
+void stop_event_listener();
@@ -0,0 +1,91 @@
+// ListenerSockets.cpp
+#include "ListenerSockets.hpp"
+
+#include <obs-module.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+int open_tcp_listener(unsigned short port) {
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        blog(LOG_ERROR, "[hot-cue-mesh] socket() failed: %s", std::strerror(errno));
+        return -1;
+    }
+
+    const int reuse_addr = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse_addr, sizeof(reuse_addr));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+        blog(LOG_ERROR, "[hot-cue-mesh] bind() failed on 127.0.0.1:%u: %s", port, std::strerror(errno));
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, SOMAXCONN) < 0) {
+        blog(LOG_ERROR, "[hot-cue-mesh] listen() failed: %s", std::strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int open_unix_listener(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        blog(LOG_ERROR, "[hot-cue-mesh] unix socket path too long: %s", path.c_str());
+        return -1;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        blog(LOG_ERROR, "[hot-cue-mesh] socket(AF_UNIX) failed: %s", std::strerror(errno));
+        return -1;
+    }
+
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+        blog(LOG_ERROR, "[hot-cue-mesh] bind() failed on %s: %s", path.c_str(), std::strerror(errno));
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, SOMAXCONN) < 0) {
+        blog(LOG_ERROR, "[hot-cue-mesh] listen() failed on %s: %s", path.c_str(), std::strerror(errno));
+        close(fd);
+        unlink(path.c_str());
+        return -1;
+    }
+    return fd;
+}
+
+int open_udp_socket(unsigned short port) {
+    const int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        blog(LOG_ERROR, "[hot-cue-mesh] socket(SOCK_DGRAM) failed: %s", std::strerror(errno));
+        return -1;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+        blog(LOG_ERROR, "[hot-cue-mesh] bind() failed on udp 127.0.0.1:%u: %s", port, std::strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
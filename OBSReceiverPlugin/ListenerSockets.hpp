@@ -0,0 +1,10 @@
+// ListenerSockets.hpp
+#pragma once
+
+#include <string>
+
+// Non-blocking, close-on-exec listening sockets shared by the listener
+// backends. Each returns -1 (after logging why) on failure.
+int open_tcp_listener(unsigned short port);
+int open_unix_listener(const std::string& path);
+int open_udp_socket(unsigned short port);
@@ -0,0 +1,135 @@
+// MessageSlab.cpp
+#include "MessageSlab.hpp"
+#include "MpscRing.hpp"
+
+#include <cstring>
+#include <memory>
+
+namespace {
+
+class SlabPool {
+public:
+    SlabPool()
+        : slabs_(std::make_unique<MessageSlab[]>(kMessageSlabPoolSize)),
+          free_(kMessageSlabPoolSize) {
+        for (size_t i = 0; i < kMessageSlabPoolSize; ++i) {
+            MessageSlab* slab = &slabs_[i];
+            slab->pooled = true;
+            free_.try_push(slab);
+        }
+    }
+
+    MessageSlab* acquire() {
+        MessageSlab* slab = nullptr;
+        if (free_.try_pop(slab)) {
+            pooled_acquires_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            heap_fallbacks_.fetch_add(1, std::memory_order_relaxed);
+            slab = new MessageSlab();
+        }
+        slab->refs.store(1, std::memory_order_relaxed);
+        return slab;
+    }
+
+    void recycle(MessageSlab* slab) {
+        if (!slab->pooled) {
+            delete slab;
+            return;
+        }
+        // Can't fail: there are exactly as many free-list slots as pooled slabs.
+        free_.try_push(slab);
+    }
+
+    MessageSlabStats stats() const {
+        MessageSlabStats s;
+        s.pooled_acquires = pooled_acquires_.load(std::memory_order_relaxed);
+        s.heap_fallbacks = heap_fallbacks_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    std::unique_ptr<MessageSlab[]> slabs_;
+    MpscRing<MessageSlab*> free_;
+    std::atomic<uint64_t> pooled_acquires_{0};
+    std::atomic<uint64_t> heap_fallbacks_{0};
+};
+
+SlabPool& pool() {
+    static SlabPool instance;
+    return instance;
+}
+
+} // namespace
+
+MessageSlab* acquire_message_slab() {
+    return pool().acquire();
+}
+
+void retain_message_slab(MessageSlab* slab) noexcept {
+    slab->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void release_message_slab(MessageSlab* slab) noexcept {
+    if (slab->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        pool().recycle(slab);
+    }
+}
+
+MessageSlabStats message_slab_stats() {
+    return pool().stats();
+}
+
+EventMessage::EventMessage(MessageSlab* slab, uint32_t offset, uint32_t length) noexcept
+    : slab_(slab), offset_(offset), length_(length) {
+    retain_message_slab(slab_);
+}
+
+EventMessage::EventMessage(EventMessage&& other) noexcept
+    : slab_(other.slab_), offset_(other.offset_), length_(other.length_) {
+    other.slab_ = nullptr;
+    other.offset_ = 0;
+    other.length_ = 0;
+}
+
+EventMessage& EventMessage::operator=(EventMessage&& other) noexcept {
+    if (this != &other) {
+        reset();
+        slab_ = other.slab_;
+        offset_ = other.offset_;
+        length_ = other.length_;
+        other.slab_ = nullptr;
+        other.offset_ = 0;
+        other.length_ = 0;
+    }
+    return *this;
+}
+
+EventMessage::~EventMessage() {
+    reset();
+}
+
+void EventMessage::reset() noexcept {
+    if (slab_) release_message_slab(slab_);
+    slab_ = nullptr;
+    offset_ = 0;
+    length_ = 0;
+}
+
+SlabWriter::~SlabWriter() {
+    if (slab_) release_message_slab(slab_);
+}
+
+EventMessage SlabWriter::write(std::string_view text) {
+    if (text.empty() || text.size() > kMessageSlabSize) return {};
+
+    if (!slab_ || kMessageSlabSize - used_ < text.size()) {
+        if (slab_) release_message_slab(slab_);
+        slab_ = acquire_message_slab();
+        used_ = 0;
+    }
+
+    std::memcpy(slab_->data + used_, text.data(), text.size());
+    EventMessage message(slab_, used_, static_cast<uint32_t>(text.size()));
+    used_ += static_cast<uint32_t>(text.size());
+    return message;
+}
@@ -0,0 +1,77 @@
+// MessageSlab.hpp
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Ingest threads receive straight into fixed-size slabs taken from a pool
+// allocated once at startup; every complete line is published as an
+// EventMessage, a refcounted view into its slab. A slab goes back to the pool
+// when the last message pointing into it is destroyed, so steady-state ingest
+// does no heap allocation. If the pool runs dry a heap slab is used instead
+// and counted in MessageSlabStats::heap_fallbacks.
+
+constexpr size_t kMessageSlabSize = 16 * 1024; // bounds the longest accepted line
+constexpr size_t kMessageSlabPoolSize = 256;
+
+struct MessageSlab {
+    std::atomic<uint32_t> refs{0};
+    bool pooled = false;
+    alignas(64) char data[kMessageSlabSize];
+};
+
+// Returns a slab with one reference owned by the caller.
+MessageSlab* acquire_message_slab();
+void retain_message_slab(MessageSlab* slab) noexcept;
+void release_message_slab(MessageSlab* slab) noexcept;
+
+struct MessageSlabStats {
+    uint64_t pooled_acquires = 0;
+    uint64_t heap_fallbacks = 0;
+};
+
+MessageSlabStats message_slab_stats();
+
+// One event line. Move-only; holds a reference on the slab it points into.
+class EventMessage {
+public:
+    EventMessage() = default;
+    // Takes a new reference on slab.
+    EventMessage(MessageSlab* slab, uint32_t offset, uint32_t length) noexcept;
+    EventMessage(EventMessage&& other) noexcept;
+    EventMessage& operator=(EventMessage&& other) noexcept;
+    EventMessage(const EventMessage&) = delete;
+    EventMessage& operator=(const EventMessage&) = delete;
+    ~EventMessage();
+
+    std::string_view view() const noexcept {
+        return slab_ ? std::string_view(slab_->data + offset_, length_) : std::string_view{};
+    }
+    bool empty() const noexcept { return length_ == 0; }
+
+private:
+    void reset() noexcept;
+
+    MessageSlab* slab_ = nullptr;
+    uint32_t offset_ = 0;
+    uint32_t length_ = 0;
+};
+
+// Packs already-assembled lines (shared memory records, decoded OSC) into
+// slabs. One writer per producer thread.
+class SlabWriter {
+public:
+    SlabWriter() = default;
+    SlabWriter(const SlabWriter&) = delete;
+    SlabWriter& operator=(const SlabWriter&) = delete;
+    ~SlabWriter();
+
+    // Returns an empty message if text is longer than a slab.
+    EventMessage write(std::string_view text);
+
+private:
+    MessageSlab* slab_ = nullptr;
+    uint32_t used_ = 0;
+};
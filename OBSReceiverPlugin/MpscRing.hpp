@@ -0,0 +1,106 @@
+// MpscRing.hpp
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free multi-producer/single-consumer ring.
+//
+// Every slot is allocated up front and carries a sequence number (Vyukov's
+// bounded queue): a producer claims a position with one CAS on tail_, moves
+// its value into the slot and publishes it by bumping the slot's sequence.
+// The pop side claims positions with a CAS as well, so a producer may evict
+// the oldest entry when the ring is full (drop-oldest overflow). In normal
+// operation only the single consumer pops and that CAS never fails.
+template <typename T>
+class MpscRing {
+public:
+    // Capacity is rounded up to the next power of two.
+    explicit MpscRing(size_t capacity)
+        : capacity_(round_up_pow2(capacity < 2 ? 2 : capacity)),
+          mask_(capacity_ - 1),
+          slots_(std::make_unique<Slot[]>(capacity_)) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    // Safe from any number of threads. Returns false if the ring is full;
+    // value is left untouched in that case.
+    bool try_push(T& value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos & mask_];
+            const size_t seq = slot.seq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Normally called by the consumer thread; producers only call it to
+    // evict the oldest entry. Returns false if the ring is empty.
+    bool try_pop(T& out) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos & mask_];
+            const size_t seq = slot.seq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = std::move(slot.value);
+                    slot.seq.store(pos + capacity_, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Approximate when called concurrently with producers.
+    size_t size_approx() const {
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        const size_t head = head_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty_approx() const { return size_approx() == 0; }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<size_t> seq{0};
+        T value{};
+    };
+
+    static size_t round_up_pow2(size_t v) {
+        size_t p = 1;
+        while (p < v) p <<= 1;
+        return p;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::atomic<size_t> head_{0};
+};
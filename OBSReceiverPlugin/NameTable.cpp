@@ -0,0 +1,115 @@
+// NameTable.cpp
+#include "NameTable.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+constexpr size_t kChunkShift = 8;
+constexpr size_t kChunkSize = size_t{1} << kChunkShift;
+constexpr size_t kChunkCount = kMaxInternedNames / kChunkSize;
+
+// Names live in fixed chunks that are allocated once and never move, so
+// name_view() can read them without a lock while other threads intern.
+class NameTable {
+public:
+    NameTable() {
+        for (auto& chunk : chunks_) {
+            chunk.store(nullptr, std::memory_order_relaxed);
+        }
+        // Slot 0 is kNoName.
+        chunks_[0].store(new std::string[kChunkSize], std::memory_order_release);
+        count_.store(1, std::memory_order_release);
+    }
+
+    ~NameTable() {
+        for (auto& chunk : chunks_) {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool intern(std::string_view name, NameId& out) {
+        if (name.empty()) {
+            out = kNoName;
+            return true;
+        }
+
+        {
+            std::shared_lock<std::shared_mutex> lock(m_);
+            if (auto it = index_.find(name); it != index_.end()) {
+                out = it->second;
+                return true;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(m_);
+        // Another thread may have added it while we waited.
+        if (auto it = index_.find(name); it != index_.end()) {
+            out = it->second;
+            return true;
+        }
+
+        const size_t id = count_.load(std::memory_order_relaxed);
+        if (id >= kMaxInternedNames) return false;
+
+        std::string* chunk = chunks_[id >> kChunkShift].load(std::memory_order_relaxed);
+        if (!chunk) {
+            chunk = new std::string[kChunkSize];
+            chunks_[id >> kChunkShift].store(chunk, std::memory_order_release);
+        }
+
+        std::string& slot = chunk[id & (kChunkSize - 1)];
+        slot.assign(name.data(), name.size());
+        index_.emplace(std::string_view(slot), static_cast<NameId>(id));
+        count_.store(id + 1, std::memory_order_release);
+
+        out = static_cast<NameId>(id);
+        return true;
+    }
+
+    std::string_view view(NameId id) const noexcept {
+        if (id >= kMaxInternedNames) return {};
+        const std::string* chunk = chunks_[id >> kChunkShift].load(std::memory_order_acquire);
+        return chunk ? std::string_view(chunk[id & (kChunkSize - 1)]) : std::string_view();
+    }
+
+    size_t count() const noexcept {
+        return count_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<std::string*> chunks_[kChunkCount];
+    std::atomic<size_t> count_{0};
+
+    std::shared_mutex m_;
+    std::unordered_map<std::string_view, NameId> index_;
+};
+
+NameTable& table() {
+    static NameTable instance;
+    return instance;
+}
+
+} // namespace
+
+bool intern_name(std::string_view name, NameId& out) {
+    return table().intern(name, out);
+}
+
+std::string_view name_view(NameId id) noexcept {
+    return table().view(id);
+}
+
+size_t interned_name_count() noexcept {
+    // Not counting kNoName.
+    return table().count() - 1;
+}
+
+bool is_interned(NameId id) noexcept {
+    return id != kNoName && id < table().count();
+}
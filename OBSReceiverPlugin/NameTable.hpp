@@ -0,0 +1,31 @@
+// NameTable.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Scene, source and filter names are interned by the ingest threads so that
+// parsed commands carry small integer handles instead of strings. Handles are
+// never reused; a name keeps its handle for the lifetime of the plugin.
+using NameId = uint32_t;
+
+// The empty name. Every other handle is > 0.
+constexpr NameId kNoName = 0;
+
+constexpr size_t kMaxInternedNames = 64 * 1024;
+
+// Returns false once kMaxInternedNames distinct names have been seen. An empty
+// name always succeeds with kNoName. Thread-safe.
+bool intern_name(std::string_view name, NameId& out);
+
+// Lock-free. id must have been returned by intern_name(), and that call must
+// happen-before this one (e.g. the id arrived through the event channel). The
+// view is NUL-terminated, so data() can be handed to C APIs.
+std::string_view name_view(NameId id) noexcept;
+
+size_t interned_name_count() noexcept;
+
+// Whether id names something, i.e. was handed out by intern_name() and is not
+// kNoName. Lock-free; lets callers accept raw handles from the outside.
+bool is_interned(NameId id) noexcept;
@@ -1,7 +1,21 @@
 #include "ObsEvents.hpp"
+#include "BinaryFraming.hpp"
+#include "Channel.hpp"
+#include "CommandTable.hpp"
+#include "SourceCache.hpp"
 #include <obs-module.h>
+#include <obs-frontend-api.h>
+#include <util/platform.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <cstdint>
+#include <memory>
+#include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 
 namespace {
 
@@ -31,52 +45,16 @@ inline std::string_view next_token(std::string_view text, size_t &cursor) noexce
 	return text.substr(start, cursor - start);
 }
 
-enum class EventType : uint8_t {
-	ShowSource,
-	HideSource,
-	ToggleSource,
-	ShowFilter,
-	HideFilter,
-	ToggleFilter,
-	SwitchScene,
-	Unknown,
-};
-
-inline EventType parse_event_type(const std::string_view token) noexcept
-{
-	switch (token.size()) {
-	case 11:
-		if (token == "show_source")
-			return EventType::ShowSource;
-		if (token == "hide_source")
-			return EventType::HideSource;
-		break;
-	case 12:
-		if (token == "show_filter")
-			return EventType::ShowFilter;
-		if (token == "hide_filter")
-			return EventType::HideFilter;
-		if (token == "switch_scene")
-			return EventType::SwitchScene;
-		break;
-	case 13:
-		if (token == "toggle_source")
-			return EventType::ToggleSource;
-		if (token == "toggle_filter")
-			return EventType::ToggleFilter;
-		break;
-	}
-
-	return EventType::Unknown;
-}
-
+// Values of the "-key value" arguments of one command. A key given without a
+// value counts as absent.
 struct ParsedEventArgs {
-	std::string_view scene_name;
-	std::string_view source_name;
-	std::string_view filter_name;
+	std::array<std::string_view, kArgKeyCount> values{};
+	ArgMask present = 0;
+
+	std::string_view operator[](const ArgKey key) const noexcept { return values[static_cast<size_t>(key)]; }
 };
 
-inline bool parse_event_segment(std::string_view segment, EventType &out_type,
+inline bool parse_event_segment(std::string_view segment, const CommandDef *&out_def,
 				std::string_view &out_type_token, ParsedEventArgs &out_args) noexcept
 {
 	trim_ascii_ws(segment);
@@ -88,7 +66,7 @@ inline bool parse_event_segment(std::string_view segment, EventType &out_type,
 	if (out_type_token.empty())
 		return false;
 
-	out_type = parse_event_type(out_type_token);
+	out_def = find_command_def(out_type_token);
 	out_args = {};
 
 	while (true) {
@@ -100,7 +78,6 @@ inline bool parse_event_segment(std::string_view segment, EventType &out_type,
 			continue;
 		}
 
-		const std::string_view key = token.substr(1);
 		const size_t value_cursor = cursor;
 		std::string_view value = next_token(segment, cursor);
 		if (!value.empty() && value.front() == '-') {
@@ -108,63 +85,993 @@ inline bool parse_event_segment(std::string_view segment, EventType &out_type,
 			value = {};
 		}
 
-		if (key == "scene_name") {
-			out_args.scene_name = value;
-		} else if (key == "source_name") {
-			out_args.source_name = value;
-		} else if (key == "filter_name") {
-			out_args.filter_name = value;
+		// Unknown keys are skipped, so senders may pass extra ones along.
+		const ArgKey key = find_arg_key(token.substr(1));
+		if (key == ArgKey::Count)
+			continue;
+		out_args.values[static_cast<size_t>(key)] = value;
+		if (value.empty()) {
+			out_args.present &= static_cast<ArgMask>(~arg_bit(key));
+		} else {
+			out_args.present |= arg_bit(key);
 		}
 	}
 
 	return true;
 }
 
-} // namespace
+enum class ArgProblem : uint8_t {
+	None,
+	Missing,     // a required argument is absent
+	NotAccepted, // an argument the command does not take
+	NoneOf,      // none of def.one_of is present
+};
 
-void on_hot_cue_event(const std::string& event, StringChannel& channel) {
-	static_cast<void>(channel);
-	blog(LOG_INFO, "[hot-cue-mesh] received event: %s", event.c_str());
-	process_event(event);
+// Checks the arguments present against def. For Missing and NotAccepted,
+// out_key is the first offending argument.
+inline ArgProblem check_args(const CommandDef &def, const ArgMask present, ArgKey &out_key) noexcept
+{
+	const auto first_of = [](const ArgMask mask) {
+		for (size_t i = 0; i < kArgKeyCount; ++i) {
+			if (mask & arg_bit(static_cast<ArgKey>(i)))
+				return static_cast<ArgKey>(i);
+		}
+		return ArgKey::Count;
+	};
+
+	if (const ArgMask absent = def.required & ~present; absent != 0) {
+		out_key = first_of(absent);
+		return ArgProblem::Missing;
+	}
+	if (const ArgMask extra = present & ~def.allowed; extra != 0) {
+		out_key = first_of(extra);
+		return ArgProblem::NotAccepted;
+	}
+	if (def.one_of != 0 && (present & def.one_of) == 0)
+		return ArgProblem::NoneOf;
+	return ArgProblem::None;
 }
 
-void process_event(const std::string& event) {
-	std::string_view remaining(event);
+void log_arg_problem(const CommandDef &def, const ArgProblem problem, const ArgKey key)
+{
+	if (problem == ArgProblem::NoneOf) {
+		std::string keys;
+		for (size_t i = 0; i < kArgKeyCount; ++i) {
+			if (!(def.one_of & arg_bit(static_cast<ArgKey>(i))))
+				continue;
+			keys += keys.empty() ? "-" : " or -";
+			keys += arg_name(static_cast<ArgKey>(i));
+		}
+		blog(LOG_WARNING, "[hot-cue-mesh] %s: needs %s", def.name.data(), keys.c_str());
+		return;
+	}
+
+	const std::string_view name = arg_name(key);
+	blog(LOG_WARNING, "[hot-cue-mesh] %s: %s -%.*s", def.name.data(),
+	     problem == ArgProblem::Missing ? "missing argument" : "does not take", static_cast<int>(name.size()),
+	     name.data());
+}
+
+// Net effect on a visibility/enabled flag.
+enum class FlagAction : uint8_t {
+	Noop,
+	Show,
+	Hide,
+	Toggle,
+};
+
+constexpr FlagAction flag_action_of(const EventType type) noexcept
+{
+	switch (type) {
+	case EventType::ShowSource:
+	case EventType::ShowFilter:
+		return FlagAction::Show;
+	case EventType::HideSource:
+	case EventType::HideFilter:
+		return FlagAction::Hide;
+	case EventType::ToggleSource:
+	case EventType::ToggleFilter:
+		return FlagAction::Toggle;
+	default:
+		return FlagAction::Noop;
+	}
+}
+
+constexpr EventType event_type_for(const TargetClass target, const FlagAction action) noexcept
+{
+	const bool source = target == TargetClass::SceneItem;
+	switch (action) {
+	case FlagAction::Show:
+		return source ? EventType::ShowSource : EventType::ShowFilter;
+	case FlagAction::Hide:
+		return source ? EventType::HideSource : EventType::HideFilter;
+	case FlagAction::Toggle:
+		return source ? EventType::ToggleSource : EventType::ToggleFilter;
+	case FlagAction::Noop:
+		break;
+	}
+	return EventType::Unknown;
+}
+
+// Applying first and then next is the same as applying the result once.
+constexpr FlagAction compose(const FlagAction first, const FlagAction next) noexcept
+{
+	if (next != FlagAction::Toggle)
+		return next == FlagAction::Noop ? first : next;
+
+	switch (first) {
+	case FlagAction::Show:
+		return FlagAction::Hide;
+	case FlagAction::Hide:
+		return FlagAction::Show;
+	case FlagAction::Toggle:
+		return FlagAction::Noop;
+	case FlagAction::Noop:
+		break;
+	}
+	return FlagAction::Toggle;
+}
+
+inline bool parse_u64(const std::string_view text, uint64_t &out) noexcept
+{
+	const char *end = text.data() + text.size();
+	const auto [ptr, ec] = std::from_chars(text.data(), end, out);
+	return ec == std::errc() && ptr == end;
+}
+
+enum class NameArgResult : uint8_t {
+	Ok,
+	TableFull,
+	UnknownId,
+};
+
+// "#<n>" is the id /obsState reported for a scene, source or filter (its
+// NameId), taken as is without hashing the name; anything else is a name and
+// gets interned. Sets by_id if an id was used.
+inline NameArgResult resolve_name_arg(const std::string_view value, NameId &out, bool &by_id) noexcept
+{
+	uint64_t id = 0;
+	if (value.size() > 1 && value.front() == '#' && parse_u64(value.substr(1), id)) {
+		by_id = true;
+		if (id > UINT32_MAX || !is_interned(static_cast<NameId>(id)))
+			return NameArgResult::UnknownId;
+		out = static_cast<NameId>(id);
+		return NameArgResult::Ok;
+	}
+	return intern_name(value, out) ? NameArgResult::Ok : NameArgResult::TableFull;
+}
+
+inline NameArgResult resolve_name_args(const ParsedEventArgs &args, EventCommand &command, bool &by_id) noexcept
+{
+	const std::pair<ArgKey, NameId *> targets[] = {
+		{ArgKey::SceneName, &command.scene},
+		{ArgKey::SourceName, &command.source},
+		{ArgKey::FilterName, &command.filter},
+	};
+	for (const auto &[key, out] : targets) {
+		const NameArgResult result = resolve_name_arg(args[key], *out, by_id);
+		if (result != NameArgResult::Ok)
+			return result;
+	}
+	return NameArgResult::Ok;
+}
+
+// -in_ms and -ttl_ms over kMaxOffsetMs, or an -at_ns further ahead than
+// that, are rejected, so due_ns and expires_ns can never overflow.
+constexpr bool at_ns_in_range(const uint64_t at_ns, const uint64_t received_ns) noexcept
+{
+	return at_ns <= received_ns + kMaxOffsetMs * 1'000'000;
+}
+
+// -at_ns is an absolute os_gettime_ns() time (CLOCK_MONOTONIC on Linux, so
+// same-host senders can compute it), -in_ms an offset from received_ns, when
+// the line was parsed. -at_ns wins if both are given.
+inline bool parse_due_time(const ParsedEventArgs &args, const uint64_t received_ns, uint64_t &out) noexcept
+{
+	out = 0;
+	if (!args[ArgKey::AtNs].empty())
+		return parse_u64(args[ArgKey::AtNs], out) && at_ns_in_range(out, received_ns);
+
+	uint64_t offset_ms = 0;
+	if (args[ArgKey::InMs].empty())
+		return true;
+	if (!parse_u64(args[ArgKey::InMs], offset_ms) || offset_ms > kMaxOffsetMs)
+		return false;
+	out = received_ns + offset_ms * 1'000'000;
+	return true;
+}
+
+inline bool parse_lane(const std::string_view text, Lane &out) noexcept
+{
+	if (text == "high") {
+		out = Lane::High;
+	} else if (text == "normal") {
+		out = Lane::Normal;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+// The lane of every begin/commit group open on this ingest thread, by origin.
+// EventBatch keeps its own view of groups on the tick; this one only keeps
+// every line of a group in the lane the group was opened in. An origin is
+// only ever parsed on the thread of its listener, so no lock is needed;
+// end_event_origin() forgets it.
+thread_local std::unordered_map<uint16_t, Lane> t_open_group_lanes;
+
+// Puts the commands of one line or frame, [first, out.end()), into one lane:
+// the group's if the line continues a group origin has open, line_lane
+// otherwise. A unit split across lanes could reach the tick in pieces.
+void assign_line_lane(std::vector<EventCommand> &out, const size_t first, const Lane line_lane, const uint16_t origin)
+{
+	const auto open = t_open_group_lanes.find(origin);
+	const bool in_group = open != t_open_group_lanes.end();
+	const Lane lane = in_group ? open->second : line_lane;
+	for (size_t i = first; i < out.size(); ++i) {
+		EventCommand &command = out[i];
+		if (lane == Lane::High)
+			command.flags |= kCommandHighPriority;
+		if (command.type == EventType::BeginBatch) {
+			t_open_group_lanes.emplace(origin, lane);
+		} else if (command.type == EventType::CommitBatch) {
+			t_open_group_lanes.erase(origin);
+		}
+	}
+}
+
+// -ttl_ms counts from the target time of a timed command, else from arrival.
+constexpr uint64_t expiry_after(const EventCommand &command, const uint64_t ttl_ms) noexcept
+{
+	return (command.due_ns != 0 ? command.due_ns : command.received_ns) + ttl_ms * 1'000'000;
+}
+
+std::atomic<bool> g_name_table_full_logged{false};
+
+void log_name_table_full()
+{
+	if (!g_name_table_full_logged.exchange(true, std::memory_order_relaxed)) {
+		blog(LOG_WARNING, "[hot-cue-mesh] more than %zu distinct names, dropping commands with new ones",
+		     kMaxInternedNames);
+	}
+}
+
+constexpr ArgMask kNameArgs = arg_bit(ArgKey::SceneName) | arg_bit(ArgKey::SourceName) | arg_bit(ArgKey::FilterName);
+
+// Arguments of one binary command (see BinaryFraming.hpp), read straight off
+// the wire.
+struct FrameArgs {
+	ArgMask present = 0;
+	ArgMask by_id = 0; // name arguments given as an id
+	std::array<std::string_view, kArgKeyCount> names{};
+	std::array<uint64_t, kArgKeyCount> numbers{}; // ids and number arguments
+
+	uint64_t operator[](const ArgKey key) const noexcept { return numbers[static_cast<size_t>(key)]; }
+};
+
+class FrameReader {
+public:
+	explicit FrameReader(const std::string_view frame)
+		: data_(reinterpret_cast<const uint8_t *>(frame.data())), size_(frame.size())
+	{
+	}
+
+	bool at_end() const noexcept { return pos_ >= size_; }
+
+	bool read_u8(uint8_t &out) noexcept
+	{
+		if (pos_ >= size_)
+			return false;
+		out = data_[pos_++];
+		return true;
+	}
+
+	bool read_varint(uint64_t &out) noexcept
+	{
+		size_t used = 0;
+		if (::read_varint(data_ + pos_, size_ - pos_, out, used) != VarintResult::Ok)
+			return false;
+		pos_ += used;
+		return true;
+	}
+
+	bool read_args(const ArgMask mask, FrameArgs &out) noexcept
+	{
+		out.present = mask;
+		for (size_t i = 0; i < kArgKeyCount; ++i) {
+			const ArgMask bit = arg_bit(static_cast<ArgKey>(i));
+			if (!(mask & bit))
+				continue;
+			uint64_t value = 0;
+			if (!read_varint(value))
+				return false;
+			if (!(kNameArgs & bit)) {
+				out.numbers[i] = value;
+			} else if (value & 1) {
+				out.by_id |= bit;
+				out.numbers[i] = value >> 1;
+			} else {
+				const uint64_t length = value >> 1;
+				if (length > size_ - pos_)
+					return false;
+				out.names[i] = std::string_view(reinterpret_cast<const char *>(data_ + pos_),
+								static_cast<size_t>(length));
+				pos_ += static_cast<size_t>(length);
+			}
+		}
+		return true;
+	}
+
+private:
+	const uint8_t *data_;
+	size_t size_;
+	size_t pos_ = 0;
+};
+
+// Like resolve_name_args(), for a binary command.
+inline NameArgResult resolve_frame_names(const FrameArgs &args, EventCommand &command) noexcept
+{
+	const std::pair<ArgKey, NameId *> targets[] = {
+		{ArgKey::SceneName, &command.scene},
+		{ArgKey::SourceName, &command.source},
+		{ArgKey::FilterName, &command.filter},
+	};
+	for (const auto &[key, out] : targets) {
+		if (args.by_id & arg_bit(key)) {
+			const uint64_t id = args[key];
+			if (id > UINT32_MAX || !is_interned(static_cast<NameId>(id)))
+				return NameArgResult::UnknownId;
+			*out = static_cast<NameId>(id);
+		} else if (!intern_name(args.names[static_cast<size_t>(key)], *out)) {
+			return NameArgResult::TableFull;
+		}
+	}
+	return NameArgResult::Ok;
+}
+
+inline bool apply_flag(const FlagAction action, const bool current) noexcept
+{
+	return action == FlagAction::Toggle ? !current : action == FlagAction::Show;
+}
+
+// A command with its target already resolved. Resolving every command of a
+// unit before touching any of them keeps cache misses and scene walks out of
+// the window in which the unit is applied.
+struct StagedCommand {
+	EventType type = EventType::Unknown;
+	ObsSceneItemPtr item;  // show/hide/toggle_source
+	ObsSourcePtr source;   // the filter, or the scene to switch to
+	uint64_t received_ns = 0; // 0 for timed commands, whose delay is wanted
+};
+
+bool stage_scene_item_command(const EventCommand &command, StagedCommand &out)
+{
+	out.item = resolve_scene_item(command.scene, command.source);
+	if (!out.item) {
+		blog(LOG_WARNING, "[hot-cue-mesh] source '%s' not found in scene '%s'",
+		     name_view(command.source).data(),
+		     command.scene == kNoName ? "(current)" : name_view(command.scene).data());
+		return false;
+	}
+	return true;
+}
 
-	while (!remaining.empty()) {
-		const size_t separator = remaining.find(';');
+bool stage_filter_command(const EventCommand &command, StagedCommand &out)
+{
+	// A filter without a source lives on the scene itself.
+	const NameId owner = command.source != kNoName ? command.source : command.scene;
+	out.source = resolve_filter(owner, command.filter);
+	if (!out.source) {
+		blog(LOG_WARNING, "[hot-cue-mesh] filter '%s' not found on '%s'", name_view(command.filter).data(),
+		     name_view(owner).data());
+		return false;
+	}
+	return true;
+}
+
+bool stage_switch_scene(const EventCommand &command, StagedCommand &out)
+{
+	out.source = resolve_scene(command.scene);
+	if (!out.source) {
+		blog(LOG_WARNING, "[hot-cue-mesh] scene '%s' not found", name_view(command.scene).data());
+		return false;
+	}
+	return true;
+}
+
+bool stage_command(const EventCommand &command, StagedCommand &out)
+{
+	out.type = command.type;
+	out.received_ns = command.due_ns == 0 ? command.received_ns : 0;
+	switch (command.type) {
+	case EventType::ShowSource:
+	case EventType::HideSource:
+	case EventType::ToggleSource:
+		return stage_scene_item_command(command, out);
+	case EventType::ShowFilter:
+	case EventType::HideFilter:
+	case EventType::ToggleFilter:
+		return stage_filter_command(command, out);
+	case EventType::SwitchScene:
+		return stage_switch_scene(command, out);
+	case EventType::BeginBatch:
+	case EventType::CommitBatch:
+	case EventType::EndOrigin:
+	case EventType::Unknown:
+		break;
+	}
+	return false;
+}
+
+// Toggles read the current state here, not when staging.
+void apply_staged(const StagedCommand &command)
+{
+	switch (target_class_of(command.type)) {
+	case TargetClass::SceneItem: {
+		obs_sceneitem_t *item = command.item.get();
+		obs_sceneitem_set_visible(item, apply_flag(flag_action_of(command.type), obs_sceneitem_visible(item)));
+		break;
+	}
+	case TargetClass::Filter: {
+		obs_source_t *filter = command.source.get();
+		obs_source_set_enabled(filter, apply_flag(flag_action_of(command.type), obs_source_enabled(filter)));
+		break;
+	}
+	case TargetClass::ProgramScene:
+		// UI thread only; see execute_unit().
+		obs_frontend_set_current_scene(command.source.get());
+		break;
+	case TargetClass::None:
+		break;
+	}
+}
+
+LatencyHistogram g_apply_latency;
+
+void record_apply_latency(const StagedCommand &command, const uint64_t applied_ns)
+{
+	if (command.received_ns != 0 && applied_ns >= command.received_ns)
+		g_apply_latency.record(applied_ns - command.received_ns);
+}
+
+// Scene switches handed to the UI thread and not applied yet. Later units
+// wait for them so units are still applied in order.
+std::atomic<uint32_t> g_ui_units_in_flight{0};
+
+// Tick thread only; reused between units.
+std::vector<StagedCommand> g_staged;
+
+} // namespace
+
+size_t parse_event_line(std::string_view line, const uint16_t origin, std::vector<EventCommand> &out)
+{
+	const uint64_t received_ns = os_gettime_ns();
+	size_t appended = 0;
+	Lane line_lane = Lane::Normal;
+
+	while (!line.empty()) {
+		const size_t separator = line.find(';');
 		const std::string_view segment =
-			(separator == std::string_view::npos) ? remaining
-							      : remaining.substr(0, separator);
+			(separator == std::string_view::npos) ? line : line.substr(0, separator);
 
 		if (separator == std::string_view::npos) {
-			remaining = {};
+			line = {};
 		} else {
-			remaining.remove_prefix(separator + 1);
+			line.remove_prefix(separator + 1);
 		}
 
-		EventType type = EventType::Unknown;
+		EventCommand command;
+		command.origin = origin;
+		command.received_ns = received_ns;
+		const CommandDef *def = nullptr;
 		std::string_view type_token;
 		ParsedEventArgs args{};
-		if (!parse_event_segment(segment, type, type_token, args)) {
+		if (!parse_event_segment(segment, def, type_token, args)) {
 			continue;
 		}
 
-		static_cast<void>(args);
-
-		switch (type) {
-		case EventType::ShowSource:
-		case EventType::HideSource:
-		case EventType::ToggleSource:
-		case EventType::ShowFilter:
-		case EventType::HideFilter:
-		case EventType::ToggleFilter:
-		case EventType::SwitchScene:
-			break;
-		case EventType::Unknown:
+		if (!def) {
 			blog(LOG_WARNING, "[hot-cue-mesh] unknown event type: %.*s",
 			     static_cast<int>(type_token.size()), type_token.data());
+			continue;
+		}
+
+		ArgKey bad_key = ArgKey::Count;
+		if (const ArgProblem problem = check_args(*def, args.present, bad_key); problem != ArgProblem::None) {
+			log_arg_problem(*def, problem, bad_key);
+			continue;
+		}
+		command.type = def->type;
+
+		if (!parse_due_time(args, received_ns, command.due_ns)) {
+			blog(LOG_WARNING, "[hot-cue-mesh] invalid target time (or more than %llu ms ahead) in: %.*s",
+			     static_cast<unsigned long long>(kMaxOffsetMs), static_cast<int>(segment.size()), segment.data());
+			continue;
+		}
+		if (uint64_t ttl_ms = 0; !args[ArgKey::TtlMs].empty()) {
+			if (!parse_u64(args[ArgKey::TtlMs], ttl_ms) || ttl_ms > kMaxOffsetMs) {
+				blog(LOG_WARNING, "[hot-cue-mesh] invalid -ttl_ms (or over %llu) in: %.*s",
+				     static_cast<unsigned long long>(kMaxOffsetMs), static_cast<int>(segment.size()),
+				     segment.data());
+				continue;
+			}
+			command.expires_ns = expiry_after(command, ttl_ms);
+		}
+
+		bool by_id = false;
+		const NameArgResult names = resolve_name_args(args, command, by_id);
+		if (names == NameArgResult::TableFull) {
+			log_name_table_full();
+			continue;
+		}
+		if (names == NameArgResult::UnknownId) {
+			blog(LOG_WARNING, "[hot-cue-mesh] unknown #id in: %.*s", static_cast<int>(segment.size()),
+			     segment.data());
+			continue;
+		}
+
+		// Ids are only good for the scene graph version /obsState gave out
+		// with them; one compare tells whether the graph changed since.
+		const std::string_view version = args[ArgKey::Version];
+		if (by_id && version.empty()) {
+			blog(LOG_WARNING, "[hot-cue-mesh] %s: #id references need -version", def->name.data());
+			continue;
+		}
+		if (uint64_t seen = 0; !version.empty() && (!parse_u64(version, seen) || seen != scene_graph_version())) {
+			blog(LOG_WARNING, "[hot-cue-mesh] %s: stale scene graph version %.*s, fetch /obsState again",
+			     def->name.data(), static_cast<int>(version.size()), version.data());
+			continue;
+		}
+
+		Lane lane = default_lane_of(def->type);
+		if (const std::string_view priority = args[ArgKey::Priority];
+		    !priority.empty() && !parse_lane(priority, lane)) {
+			blog(LOG_WARNING, "[hot-cue-mesh] %s: -priority must be high or normal, not %.*s", def->name.data(),
+			     static_cast<int>(priority.size()), priority.data());
+			continue;
+		}
+		if (lane == Lane::High)
+			line_lane = Lane::High;
+
+		out.push_back(command);
+		++appended;
+	}
+
+	if (appended > 0) {
+		assign_line_lane(out, out.size() - appended, line_lane, origin);
+		out.back().flags |= kCommandEndsLine;
+	}
+	return appended;
+}
+
+size_t parse_event_frame(const std::string_view frame, const uint16_t origin, std::vector<EventCommand> &out)
+{
+	const uint64_t received_ns = os_gettime_ns();
+	size_t appended = 0;
+	Lane frame_lane = Lane::Normal;
+
+	FrameReader reader(frame);
+	while (!reader.at_end()) {
+		uint8_t opcode = 0;
+		uint8_t mask = 0;
+		FrameArgs args;
+		// Field sizes follow from the mask, so an unknown opcode can be
+		// skipped; an unknown mask bit cannot.
+		if (!reader.read_u8(opcode) || !reader.read_u8(mask) || (static_cast<unsigned>(mask) >> kArgKeyCount) != 0 ||
+		    !reader.read_args(mask, args)) {
+			blog(LOG_WARNING, "[hot-cue-mesh] malformed binary frame (%zu bytes), dropping the rest of it",
+			     frame.size());
+			break;
+		}
+
+		const CommandDef *def = command_def_of(static_cast<EventType>(opcode));
+		if (!def) {
+			blog(LOG_WARNING, "[hot-cue-mesh] unknown binary opcode: %u", static_cast<unsigned>(opcode));
+			continue;
+		}
+
+		ArgKey bad_key = ArgKey::Count;
+		if (const ArgProblem problem = check_args(*def, args.present, bad_key); problem != ArgProblem::None) {
+			log_arg_problem(*def, problem, bad_key);
+			continue;
+		}
+
+		const bool has_at = (args.present & arg_bit(ArgKey::AtNs)) != 0;
+		const bool has_in = (args.present & arg_bit(ArgKey::InMs)) != 0;
+		const bool has_ttl = (args.present & arg_bit(ArgKey::TtlMs)) != 0;
+		if ((has_at && !at_ns_in_range(args[ArgKey::AtNs], received_ns)) ||
+		    (has_in && args[ArgKey::InMs] > kMaxOffsetMs) || (has_ttl && args[ArgKey::TtlMs] > kMaxOffsetMs)) {
+			blog(LOG_WARNING, "[hot-cue-mesh] %s: target time or -ttl_ms more than %llu ms ahead",
+			     def->name.data(), static_cast<unsigned long long>(kMaxOffsetMs));
+			continue;
+		}
+
+		EventCommand command;
+		command.type = def->type;
+		command.origin = origin;
+		command.received_ns = received_ns;
+		// -at_ns wins over -in_ms, as in the text form.
+		if (has_at) {
+			command.due_ns = args[ArgKey::AtNs];
+		} else if (has_in) {
+			command.due_ns = received_ns + args[ArgKey::InMs] * 1'000'000;
+		}
+		if (has_ttl)
+			command.expires_ns = expiry_after(command, args[ArgKey::TtlMs]);
+
+		const NameArgResult names = resolve_frame_names(args, command);
+		if (names == NameArgResult::TableFull) {
+			log_name_table_full();
+			continue;
+		}
+		if (names == NameArgResult::UnknownId) {
+			blog(LOG_WARNING, "[hot-cue-mesh] %s: unknown id", def->name.data());
+			continue;
+		}
+
+		const bool has_version = (args.present & arg_bit(ArgKey::Version)) != 0;
+		if (args.by_id != 0 && !has_version) {
+			blog(LOG_WARNING, "[hot-cue-mesh] %s: #id references need -version", def->name.data());
+			continue;
+		}
+		if (has_version && args[ArgKey::Version] != scene_graph_version()) {
+			blog(LOG_WARNING, "[hot-cue-mesh] %s: stale scene graph version %llu, fetch /obsState again",
+			     def->name.data(), static_cast<unsigned long long>(args[ArgKey::Version]));
+			continue;
+		}
+
+		Lane lane = default_lane_of(def->type);
+		if (args.present & arg_bit(ArgKey::Priority)) {
+			if (args[ArgKey::Priority] >= kLaneCount) {
+				blog(LOG_WARNING, "[hot-cue-mesh] %s: unknown priority %llu", def->name.data(),
+				     static_cast<unsigned long long>(args[ArgKey::Priority]));
+				continue;
+			}
+			lane = static_cast<Lane>(args[ArgKey::Priority]);
+		}
+		if (lane == Lane::High)
+			frame_lane = Lane::High;
+
+		out.push_back(command);
+		++appended;
+	}
+
+	if (appended > 0) {
+		assign_line_lane(out, out.size() - appended, frame_lane, origin);
+		out.back().flags |= kCommandEndsLine;
+	}
+	return appended;
+}
+
+size_t end_event_origin(const uint16_t origin, std::vector<EventCommand> &out)
+{
+	const auto open = t_open_group_lanes.find(origin);
+	if (open == t_open_group_lanes.end())
+		return 0;
+
+	EventCommand command;
+	command.type = EventType::EndOrigin;
+	command.origin = origin;
+	command.received_ns = os_gettime_ns();
+	if (open->second == Lane::High)
+		command.flags |= kCommandHighPriority;
+	t_open_group_lanes.erase(open);
+	out.push_back(command);
+	return 1;
+}
+
+size_t execute_unit(const EventCommand *commands, const size_t count)
+{
+	g_staged.clear();
+	for (size_t i = 0; i < count; ++i) {
+		StagedCommand staged;
+		if (!stage_command(commands[i], staged))
+			continue;
+		g_staged.push_back(std::move(staged));
+	}
+
+	if (g_staged.empty())
+		return 0;
+
+	// The tick runs before the frame is rendered, so everything applied
+	// here shows up on that frame together.
+	const size_t applied = g_staged.size();
+	std::unique_ptr<StagedCommand> scene_switch;
+	for (StagedCommand &command : g_staged) {
+		if (command.type == EventType::SwitchScene) {
+			// Only the last switch of a unit matters.
+			scene_switch = std::make_unique<StagedCommand>(std::move(command));
+			continue;
+		}
+		apply_staged(command);
+	}
+	const uint64_t applied_ns = os_gettime_ns();
+	for (const StagedCommand &command : g_staged) {
+		if (command.type != EventType::SwitchScene)
+			record_apply_latency(command, applied_ns);
+	}
+	g_staged.clear();
+	if (!scene_switch)
+		return applied;
+
+	// The frontend blocks the calling thread on the UI when it is not the UI
+	// thread, which must never happen on the tick, so the switch alone moves
+	// there. It takes no graphics lock: the frontend may emit signals whose
+	// handlers wait on a graphics task. The switch lands on the first frame
+	// after the UI thread gets to it.
+	g_ui_units_in_flight.fetch_add(1, std::memory_order_acq_rel);
+	obs_queue_task(
+		OBS_TASK_UI,
+		[](void *param) {
+			const std::unique_ptr<StagedCommand> command(static_cast<StagedCommand *>(param));
+			apply_staged(*command);
+			record_apply_latency(*command, os_gettime_ns());
+			g_ui_units_in_flight.fetch_sub(1, std::memory_order_acq_rel);
+		},
+		scene_switch.release(), false);
+	return applied;
+}
+
+const LatencyHistogram &apply_latency()
+{
+	return g_apply_latency;
+}
+
+void on_hot_cue_event(const std::string& event, EventChannel& channel) {
+	static_cast<void>(channel);
+	blog(LOG_INFO, "[hot-cue-mesh] received event: %s", event.c_str());
+	process_event(event);
+}
+
+void process_event(const std::string& event) {
+	std::vector<EventCommand> commands;
+	parse_event_line(event, 0, commands);
+	// Group markers and target times change nothing here; the line is applied
+	// right away as one unit.
+	execute_unit(commands.data(), commands.size());
+}
+
+void EventBatch::set_ttl(const EventType type, const uint64_t ttl_ns)
+{
+	if (static_cast<size_t>(type) < kEventTypeCount)
+		ttl_ns_[static_cast<size_t>(type)] = ttl_ns;
+}
+
+size_t EventBatch::expired(const EventType type) const
+{
+	return static_cast<size_t>(type) < kEventTypeCount ? expired_[static_cast<size_t>(type)] : 0;
+}
+
+bool EventBatch::is_stale(const EventCommand &command, const uint64_t now_ns) const
+{
+	if (command.expires_ns != 0 && now_ns > command.expires_ns)
+		return true;
+	const size_t type = static_cast<size_t>(command.type);
+	const uint64_t ttl = type < kEventTypeCount ? ttl_ns_[type] : 0;
+	if (ttl == 0)
+		return false;
+	// A timed command only starts aging at its target time.
+	const uint64_t since = command.due_ns != 0 ? command.due_ns : command.received_ns;
+	return now_ns > since && now_ns - since > ttl;
+}
+
+bool EventBatch::add(const EventCommand &command, const uint64_t now_ns)
+{
+	bool kept = true;
+	// Lanes are drained separately, so each holds its own units.
+	const uint32_t key = static_cast<uint32_t>(command.origin) << 8 | static_cast<uint32_t>(lane_of(command));
+	if (command.type == EventType::EndOrigin) {
+		// The sender is gone; a group it never committed is dropped rather
+		// than applied half done. Its complete lines were closed already.
+		if (const auto open = open_.find(key); open != open_.end()) {
+			if (open->second.in_group)
+				++abandoned_groups_;
+			open_.erase(open);
+		}
+		return true;
+	}
+	OpenUnit &unit = open_[key];
+	if (unit.commands.empty() && !unit.in_group)
+		unit.opened_tick = ticks_;
+
+	switch (command.type) {
+	case EventType::BeginBatch:
+		// Nested begins fold into the outer group.
+		unit.in_group = true;
+		break;
+	case EventType::CommitBatch:
+		// A stray commit just ends whatever is pending.
+		unit.in_group = false;
+		close_unit(unit);
+		break;
+	default:
+		if (is_stale(command, now_ns)) {
+			// Gone, but its line or group still ends below.
+			++expired_[static_cast<size_t>(command.type)];
+			kept = false;
 			break;
 		}
+		unit.commands.push_back(command);
+		if (unit.in_group && unit.commands.size() >= kMaxGroupCommands) {
+			unit.in_group = false;
+			++forced_commits_;
+			close_unit(unit);
+		}
+		break;
+	}
+
+	if (!unit.in_group && (command.flags & kCommandEndsLine))
+		close_unit(unit);
+	return kept;
+}
+
+void EventBatch::close_unit(OpenUnit &unit)
+{
+	if (unit.commands.empty())
+		return;
+
+	// Untimed commands run with this batch. Timed ones are scheduled at the
+	// next seal(), one unit per distinct target time.
+	const size_t untimed_begin = commands_.size();
+	const size_t timed_begin = timed_.size();
+	for (const EventCommand &command : unit.commands) {
+		if (command.due_ns == 0) {
+			commands_.push_back(command);
+		} else {
+			timed_.push_back(command);
+		}
 	}
+	unit.commands.clear();
+
+	if (commands_.size() > untimed_begin)
+		commands_.back().flags |= kCommandEndsUnit;
+
+	const auto timed = timed_.begin() + static_cast<std::ptrdiff_t>(timed_begin);
+	std::stable_sort(timed, timed_.end(),
+			 [](const EventCommand &a, const EventCommand &b) { return a.due_ns < b.due_ns; });
+	for (size_t i = timed_begin; i < timed_.size(); ++i) {
+		if (i + 1 == timed_.size() || timed_[i + 1].due_ns != timed_[i].due_ns)
+			timed_[i].flags |= kCommandEndsUnit;
+	}
+}
+
+void EventBatch::seal(const uint64_t now_ns, const uint64_t fire_before_ns)
+{
+	++ticks_;
+	for (auto it = open_.begin(); it != open_.end();) {
+		OpenUnit &unit = it->second;
+		if ((unit.in_group || !unit.commands.empty()) && ticks_ - unit.opened_tick > kMaxGroupTicks) {
+			blog(LOG_WARNING, "[hot-cue-mesh] committing a group left open for %u ticks", kMaxGroupTicks);
+			unit.in_group = false;
+			++forced_commits_;
+			close_unit(unit);
+		}
+		// Only origins in the middle of a unit are kept, so the map does not
+		// grow with every connection ever made.
+		if (!unit.in_group && unit.commands.empty()) {
+			it = open_.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	// A timed unit is scheduled back to back, so it stays contiguous in the
+	// wheel and fires as a whole.
+	scheduled_.advance(fire_before_ns, [this](EventCommand &command) { commands_.push_back(command); });
+	for (EventCommand &command : timed_) {
+		if (!scheduled_.schedule(command.due_ns, command))
+			commands_.push_back(command);
+	}
+	timed_.clear();
+
+	cursor_ = 0;
+	// Units held open, and timed ones fired late after a hitch, may have gone
+	// stale since add().
+	drop_stale(now_ns);
+	coalesce();
+}
+
+void EventBatch::drop_stale(const uint64_t now_ns)
+{
+	bool any = false;
+	for (EventCommand &command : commands_) {
+		if (is_stale(command, now_ns)) {
+			++expired_[static_cast<size_t>(command.type)];
+			command.type = EventType::Unknown;
+			any = true;
+		}
+	}
+	if (any)
+		compact();
+}
+
+void EventBatch::coalesce()
+{
+	// Folded-away commands are marked Unknown and then compacted out; real
+	// unknown commands never make it past parse_event_line().
+	const auto drop = [](EventCommand &command) { command.type = EventType::Unknown; };
+
+	latest_.clear();
+	for (size_t i = 0; i < commands_.size(); ++i) {
+		EventCommand &command = commands_[i];
+		const CommandTarget key = command_target(command);
+		const TargetClass target = key.target_class;
+		if (target == TargetClass::None)
+			continue;
+
+		const auto [it, inserted] = latest_.try_emplace(key, i);
+		if (inserted)
+			continue;
+
+		EventCommand &previous = commands_[it->second];
+		if (target != TargetClass::ProgramScene) {
+			// A cancelled pair leaves Noop behind, which is still a valid
+			// starting point for whatever comes next.
+			const FlagAction prior = previous.type == EventType::Unknown
+							 ? FlagAction::Noop
+							 : flag_action_of(previous.type);
+			const FlagAction net = compose(prior, flag_action_of(command.type));
+			if (net == FlagAction::Noop) {
+				drop(command);
+			} else {
+				command.type = event_type_for(target, net);
+			}
+		}
+		drop(previous);
+		it->second = i;
+	}
+
+	coalesced_ += compact();
+}
+
+size_t EventBatch::compact()
+{
+	const size_t before = commands_.size();
+	size_t kept = 0;
+	for (size_t i = 0; i < commands_.size(); ++i) {
+		const EventCommand &command = commands_[i];
+		if (command.type == EventType::Unknown) {
+			// The unit now ends at its last surviving command; if none
+			// survived, the command before it already ends a unit.
+			if ((command.flags & kCommandEndsUnit) && kept > 0)
+				commands_[kept - 1].flags |= kCommandEndsUnit;
+			continue;
+		}
+		commands_[kept++] = command;
+	}
+	commands_.resize(kept);
+	return before - kept;
+}
+
+size_t EventBatch::execute_until(const std::chrono::steady_clock::time_point deadline)
+{
+	size_t executed = 0;
+	while (cursor_ < commands_.size()) {
+		if (g_ui_units_in_flight.load(std::memory_order_acquire) > 0)
+			break;
+
+		size_t end = cursor_;
+		while (end + 1 < commands_.size() && !(commands_[end].flags & kCommandEndsUnit))
+			++end;
+		executed += execute_unit(commands_.data() + cursor_, end + 1 - cursor_);
+		cursor_ = end + 1;
+
+		if (std::chrono::steady_clock::now() >= deadline)
+			break;
+	}
+	return executed;
+}
+
+void EventBatch::clear()
+{
+	commands_.clear();
+	cursor_ = 0;
+}
+
+void EventBatch::reset()
+{
+	clear();
+	open_.clear();
+	timed_.clear();
+	scheduled_.clear();
 }
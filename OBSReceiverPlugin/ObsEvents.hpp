@@ -1,5 +1,145 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
+#include "EventCommand.hpp"
+#include "LatencyHistogram.hpp"
+#include "TimerWheel.hpp"
+
+// Parses line on the calling (ingest) thread, interning every name, and
+// appends its commands to out, tagged with origin (see LineFraming.hpp).
+// Unknown command types are logged and skipped here so the tick never sees
+// them. Returns how many were appended.
+size_t parse_event_line(std::string_view line, uint16_t origin, std::vector<EventCommand> &out);
+
+// Same for the payload of a binary frame (see BinaryFraming.hpp): its commands
+// are decoded straight from their opcodes and fields, with no tokenizing.
+size_t parse_event_frame(std::string_view frame, uint16_t origin, std::vector<EventCommand> &out);
+
+// Call on the ingest thread once origin's input ended. If it left a group
+// open, appends an EventType::EndOrigin marker in the group's lane, behind
+// the origin's last command there. Returns how many were appended.
+size_t end_event_origin(uint16_t origin, std::vector<EventCommand> &out);
+
+// Stages every command in [commands, commands + count) and then applies them
+// together, so they land on the same rendered frame. Must run on the graphics
+// thread (the tick or a graphics task). A scene switch is the exception: the
+// frontend only takes it on the UI thread, so it is queued there and lands
+// once the UI thread gets to it, and later units wait for it.
+// Returns how many commands were applied.
+size_t execute_unit(const EventCommand *commands, size_t count);
+
+// Time from parsing a command's line to applying it, for commands without a
+// target time.
+const LatencyHistogram &apply_latency();
+
+// Applies every command of event as one unit.
 void process_event(const std::string& event);
+
+// Longest offset a command may carry (-in_ms, -ttl_ms, or -at_ns from now),
+// and longest configured time to live: what EventBatch's timer wheel spans at
+// its 1 ms ticks, about 4.6 hours.
+constexpr uint64_t kMaxOffsetMs = TimerWheel<EventCommand>::kSpanTicks;
+
+// An open begin/commit group is committed as is once it holds this many
+// commands or has been open for this many sealed batches, so a sender that
+// never commits cannot hold back its own later commands forever.
+constexpr size_t kMaxGroupCommands = 256;
+constexpr uint32_t kMaxGroupTicks = 120;
+
+// The commands handled by one tick, in units: the commands an origin sent in
+// one line, or between begin and commit. Commands are held per origin until
+// their unit is complete, so a line split across drains or a group spanning
+// several lines is never applied piecemeal; incomplete units carry over to
+// later batches.
+//
+// Commands with a target time (-at_ns / -in_ms) wait in a timer wheel and
+// join the batch sealed closest to that time; those of one unit that share a
+// target time are applied together.
+//
+// Commands past their time to live (set_ttl(), or the sender's -ttl_ms) are
+// dropped unapplied, as they are added and again when the batch is sealed, so
+// after a hitch the tick catches up to the present instead of replaying every
+// stale cue.
+//
+// Lanes are kept apart: an origin's high and normal lane units are assembled
+// separately, since the high lane may be drained ahead of the other. When an
+// origin ends (EventType::EndOrigin), a group it left open is dropped.
+//
+// Commands aimed at the same (scene, source, filter) are collapsed to their
+// net effect before anything touches OBS: show+hide becomes hide, two toggles
+// cancel out, only the last switch_scene survives. Surviving commands keep
+// their relative order, at the position of the last command folded into them.
+class EventBatch {
+public:
+	bool empty() const { return cursor_ >= commands_.size(); }
+
+	// Commands of type expire once ttl_ns has passed since their arrival, or
+	// since their target time for timed ones; 0 (the default) never expires.
+	void set_ttl(EventType type, uint64_t ttl_ns);
+
+	// Only valid before seal(). Returns false if command was stale and
+	// dropped instead; the line or group it ends still ends.
+	bool add(const EventCommand &command, uint64_t now_ns);
+	// Commands in complete units.
+	size_t command_count() const { return commands_.size(); }
+
+	// Commits groups that hit kMaxGroupTicks, takes in every timed unit due
+	// by fire_before_ns, drops whatever is stale at now_ns, then coalesces
+	// every complete unit added so far. Both are os_gettime_ns() times.
+	void seal(uint64_t now_ns, uint64_t fire_before_ns);
+
+	// Executes whole units until the batch is done or deadline passes; whatever
+	// is left runs on the next call. A unit is never split across calls.
+	// Returns how many commands were executed.
+	size_t execute_until(std::chrono::steady_clock::time_point deadline);
+
+	// Drops the complete units; units still open are kept.
+	void clear();
+	// Drops everything, open and scheduled units included.
+	void reset();
+
+	size_t coalesced() const { return coalesced_; }
+	size_t forced_commits() const { return forced_commits_; }
+	// Groups dropped because their origin ended before the commit.
+	size_t abandoned_groups() const { return abandoned_groups_; }
+	// Commands of type dropped as stale.
+	size_t expired(EventType type) const;
+	size_t scheduled() const { return scheduled_.size() + timed_.size(); }
+
+private:
+	struct OpenUnit {
+		std::vector<EventCommand> commands;
+		bool in_group = false;
+		uint32_t opened_tick = 0;
+	};
+
+	void close_unit(OpenUnit &unit);
+	bool is_stale(const EventCommand &command, uint64_t now_ns) const;
+	void drop_stale(uint64_t now_ns);
+	void coalesce();
+	// Removes commands marked Unknown, keeping unit ends; returns how many.
+	size_t compact();
+
+	std::vector<EventCommand> commands_;
+	// Keyed by origin and lane.
+	std::unordered_map<uint32_t, OpenUnit> open_;
+	// Closed timed units waiting for seal() to schedule them.
+	std::vector<EventCommand> timed_;
+	TimerWheel<EventCommand> scheduled_;
+	std::unordered_map<CommandTarget, size_t, CommandTargetHash> latest_;
+	size_t cursor_ = 0;
+	uint32_t ticks_ = 0;
+	size_t coalesced_ = 0;
+	size_t forced_commits_ = 0;
+	size_t abandoned_groups_ = 0;
+	std::array<uint64_t, kEventTypeCount> ttl_ns_{};
+	std::array<size_t, kEventTypeCount> expired_{};
+};
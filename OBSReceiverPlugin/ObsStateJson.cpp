@@ -0,0 +1,378 @@
+// ObsStateJson.cpp
+#include "ObsStateJson.hpp"
+#include "JsonWriter.hpp"
+
+#include <obs-module.h>
+
+#include <algorithm>
+#include <array>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+struct SourceFlagName {
+    uint32_t flag;
+    const char *name;
+};
+
+constexpr std::array<SourceFlagName, 17> kSourceFlagNames{{
+    {OBS_SOURCE_VIDEO, "OBS_SOURCE_VIDEO"},
+    {OBS_SOURCE_AUDIO, "OBS_SOURCE_AUDIO"},
+    {OBS_SOURCE_ASYNC, "OBS_SOURCE_ASYNC"},
+    {OBS_SOURCE_CUSTOM_DRAW, "OBS_SOURCE_CUSTOM_DRAW"},
+    {OBS_SOURCE_INTERACTION, "OBS_SOURCE_INTERACTION"},
+    {OBS_SOURCE_COMPOSITE, "OBS_SOURCE_COMPOSITE"},
+    {OBS_SOURCE_DO_NOT_DUPLICATE, "OBS_SOURCE_DO_NOT_DUPLICATE"},
+    {OBS_SOURCE_DEPRECATED, "OBS_SOURCE_DEPRECATED"},
+    {OBS_SOURCE_DO_NOT_SELF_MONITOR, "OBS_SOURCE_DO_NOT_SELF_MONITOR"},
+    {OBS_SOURCE_CAP_DISABLED, "OBS_SOURCE_CAP_DISABLED"},
+    {OBS_SOURCE_MONITOR_BY_DEFAULT, "OBS_SOURCE_MONITOR_BY_DEFAULT"},
+    {OBS_SOURCE_SUBMIX, "OBS_SOURCE_SUBMIX"},
+    {OBS_SOURCE_CONTROLLABLE_MEDIA, "OBS_SOURCE_CONTROLLABLE_MEDIA"},
+    {OBS_SOURCE_CEA_708, "OBS_SOURCE_CEA_708"},
+    {OBS_SOURCE_SRGB, "OBS_SOURCE_SRGB"},
+    {OBS_SOURCE_CAP_DONT_SHOW_PROPERTIES, "OBS_SOURCE_CAP_DONT_SHOW_PROPERTIES"},
+    {OBS_SOURCE_REQUIRES_CANVAS, "OBS_SOURCE_REQUIRES_CANVAS"},
+}};
+
+// The nlohmann builders make the values in /obsState/stream patches; the
+// full body is written by write_obs_state().
+nlohmann::json::array_t build_source_flags(uint32_t flags) {
+    nlohmann::json::array_t source_flags;
+    source_flags.reserve(kSourceFlagNames.size());
+
+    for (const auto &entry : kSourceFlagNames) {
+        if (flags & entry.flag) {
+            source_flags.emplace_back(entry.name);
+        }
+    }
+
+    return source_flags;
+}
+
+nlohmann::json::array_t build_source_filters(const SourceState &source) {
+    nlohmann::json::array_t filters;
+    filters.reserve(source.filters.size());
+
+    for (const FilterState &filter : source.filters) {
+        nlohmann::json filter_json;
+        filter_json["id"] = filter.id;
+        filter_json["name"] = filter.name;
+        filter_json["enabled"] = filter.enabled;
+        filters.emplace_back(std::move(filter_json));
+    }
+
+    return filters;
+}
+
+nlohmann::json::array_t build_scene_sources(const SceneGraphSnapshot &snapshot, const SceneState &scene) {
+    nlohmann::json::array_t sources;
+    sources.reserve(scene.items.size());
+
+    for (const SceneItemState &item : scene.items) {
+        const auto it = snapshot.sources.find(item.source);
+        if (it == snapshot.sources.end()) {
+            continue;
+        }
+        const SourceState &source = *it->second;
+
+        nlohmann::json source_json;
+        source_json["id"] = source.id;
+        source_json["name"] = source.name;
+        source_json["sourceFlags"] = build_source_flags(source.output_flags);
+        source_json["filters"] = build_source_filters(source);
+        source_json["visible"] = item.visible;
+        sources.emplace_back(std::move(source_json));
+    }
+
+    return sources;
+}
+
+nlohmann::json build_scene_json(const SceneGraphSnapshot &snapshot, const SceneState &scene) {
+    nlohmann::json scene_json;
+    scene_json["id"] = scene.id;
+    scene_json["name"] = scene.name;
+    scene_json["sources"] = build_scene_sources(snapshot, scene);
+    return scene_json;
+}
+
+nlohmann::json::array_t build_scenes(const SceneGraphSnapshot &snapshot) {
+    nlohmann::json::array_t scenes;
+    scenes.reserve(snapshot.scenes.size());
+    for (const auto &scene : snapshot.scenes) {
+        scenes.emplace_back(build_scene_json(snapshot, *scene));
+    }
+    return scenes;
+}
+
+void write_source(JsonWriter &json, const SourceState &source, bool visible) {
+    json.begin_object();
+    json.key("filters");
+    json.begin_array();
+    for (const FilterState &filter : source.filters) {
+        json.begin_object();
+        json.key("enabled");
+        json.bool_value(filter.enabled);
+        json.key("id");
+        json.uint_value(filter.id);
+        json.key("name");
+        json.string_value(filter.name);
+        json.end_object();
+    }
+    json.end_array();
+    json.key("id");
+    json.uint_value(source.id);
+    json.key("name");
+    json.string_value(source.name);
+    json.key("sourceFlags");
+    json.begin_array();
+    for (const auto &entry : kSourceFlagNames) {
+        if (source.output_flags & entry.flag) {
+            json.string_value(entry.name);
+        }
+    }
+    json.end_array();
+    json.key("visible");
+    json.bool_value(visible);
+    json.end_object();
+}
+
+// What build_scene_sources() lists for a scene: items whose source is known.
+struct ListedItem {
+    const SceneItemState *item;
+    const SourceState *source;
+};
+
+std::vector<ListedItem> listed_items(const SceneGraphSnapshot &snapshot, const SceneState &scene) {
+    std::vector<ListedItem> listed;
+    listed.reserve(scene.items.size());
+    for (const SceneItemState &item : scene.items) {
+        const auto it = snapshot.sources.find(item.source);
+        if (it != snapshot.sources.end()) {
+            listed.push_back({&item, it->second.get()});
+        }
+    }
+    return listed;
+}
+
+void add_op(nlohmann::json::array_t &ops, const char *op, std::string path, nlohmann::json value) {
+    nlohmann::json entry;
+    entry["op"] = op;
+    entry["path"] = std::move(path);
+    if (!value.is_null()) entry["value"] = std::move(value);
+    ops.emplace_back(std::move(entry));
+}
+
+void diff_source(const SourceState &from, const SourceState &to, const std::string &path,
+                 nlohmann::json::array_t &ops) {
+    if (from.output_flags != to.output_flags) {
+        add_op(ops, "replace", path + "/sourceFlags", build_source_flags(to.output_flags));
+    }
+
+    bool same_filters = from.filters.size() == to.filters.size();
+    for (size_t i = 0; same_filters && i < to.filters.size(); ++i) {
+        same_filters = from.filters[i].id == to.filters[i].id;
+    }
+    if (!same_filters) {
+        add_op(ops, "replace", path + "/filters", build_source_filters(to));
+        return;
+    }
+    for (size_t i = 0; i < to.filters.size(); ++i) {
+        if (from.filters[i].enabled != to.filters[i].enabled) {
+            add_op(ops, "replace", path + "/filters/" + std::to_string(i) + "/enabled", to.filters[i].enabled);
+        }
+    }
+}
+
+// The scene at path in both documents has the same position; its id may not
+// (a rename).
+void diff_scene(const SceneGraphSnapshot &from_snapshot, const SceneState &from, const SceneGraphSnapshot &to_snapshot,
+                const SceneState &to, const std::string &path, nlohmann::json::array_t &ops) {
+    if (from.id != to.id) {
+        add_op(ops, "replace", path + "/id", to.id);
+        add_op(ops, "replace", path + "/name", to.name);
+    }
+
+    const std::vector<ListedItem> before = listed_items(from_snapshot, from);
+    const std::vector<ListedItem> after = listed_items(to_snapshot, to);
+    bool same_items = before.size() == after.size();
+    for (size_t i = 0; same_items && i < after.size(); ++i) {
+        same_items = before[i].source->id == after[i].source->id;
+    }
+    if (!same_items) {
+        add_op(ops, "replace", path + "/sources", build_scene_sources(to_snapshot, to));
+        return;
+    }
+
+    for (size_t i = 0; i < after.size(); ++i) {
+        const std::string item_path = path + "/sources/" + std::to_string(i);
+        if (before[i].item->visible != after[i].item->visible) {
+            add_op(ops, "replace", item_path + "/visible", after[i].item->visible);
+        }
+        if (before[i].source != after[i].source) {
+            diff_source(*before[i].source, *after[i].source, item_path, ops);
+        }
+    }
+}
+
+} // namespace
+
+nlohmann::json build_obs_state(const SceneGraphSnapshot &snapshot) {
+    nlohmann::json state;
+    state["scenes"] = build_scenes(snapshot);
+    state["version"] = snapshot.graph_version;
+    return state;
+}
+
+void write_obs_state(const SceneGraphSnapshot &snapshot, std::string &out) {
+    JsonWriter json(out);
+    json.begin_object();
+    json.key("scenes");
+    json.begin_array();
+    for (const auto &scene : snapshot.scenes) {
+        json.begin_object();
+        json.key("id");
+        json.uint_value(scene->id);
+        json.key("name");
+        json.string_value(scene->name);
+        json.key("sources");
+        json.begin_array();
+        for (const SceneItemState &item : scene->items) {
+            const auto it = snapshot.sources.find(item.source);
+            if (it != snapshot.sources.end()) {
+                write_source(json, *it->second, item.visible);
+            }
+        }
+        json.end_array();
+        json.end_object();
+    }
+    json.end_array();
+    json.key("version");
+    json.uint_value(snapshot.graph_version);
+    json.end_object();
+}
+
+nlohmann::json::array_t diff_obs_state(const SceneGraphSnapshot &from, const SceneGraphSnapshot &to) {
+    nlohmann::json::array_t ops;
+    if (from.graph_version != to.graph_version) {
+        add_op(ops, "replace", "/version", to.graph_version);
+    }
+
+    const auto &before = from.scenes;
+    const auto &after = to.scenes;
+    if (before.size() == after.size()) {
+        for (size_t i = 0; i < after.size(); ++i) {
+            diff_scene(from, *before[i], to, *after[i], "/scenes/" + std::to_string(i), ops);
+        }
+        return ops;
+    }
+
+    // Otherwise expect some scenes gone and some appended, the rest in order.
+    std::vector<size_t> kept;
+    std::vector<size_t> removed;
+    for (size_t i = 0; i < before.size(); ++i) {
+        const NameId id = before[i]->id;
+        const bool remains = std::any_of(after.begin(), after.end(),
+                                         [id](const std::shared_ptr<const SceneState> &scene) { return scene->id == id; });
+        (remains ? kept : removed).push_back(i);
+    }
+    bool in_order = kept.size() <= after.size();
+    for (size_t i = 0; in_order && i < kept.size(); ++i) {
+        in_order = before[kept[i]]->id == after[i]->id;
+    }
+    if (!in_order) {
+        add_op(ops, "replace", "/scenes", build_scenes(to));
+        return ops;
+    }
+
+    for (auto it = removed.rbegin(); it != removed.rend(); ++it) {
+        add_op(ops, "remove", "/scenes/" + std::to_string(*it), nullptr);
+    }
+    for (size_t i = 0; i < kept.size(); ++i) {
+        diff_scene(from, *before[kept[i]], to, *after[i], "/scenes/" + std::to_string(i), ops);
+    }
+    for (size_t i = kept.size(); i < after.size(); ++i) {
+        add_op(ops, "add", "/scenes/-", build_scene_json(to, *after[i]));
+    }
+    return ops;
+}
+
+void write_normalized_obs_state(const SceneGraphSnapshot &snapshot, std::string &out) {
+    std::vector<const SourceState *> sources;
+    std::unordered_set<NameId> listed;
+    for (const auto &scene : snapshot.scenes) {
+        for (const SceneItemState &item : scene->items) {
+            const auto it = snapshot.sources.find(item.source);
+            if (it != snapshot.sources.end() && listed.insert(item.source).second) {
+                sources.push_back(it->second.get());
+            }
+        }
+    }
+
+    uint32_t known_flags = 0;
+    JsonWriter json(out);
+    json.begin_object();
+    json.key("format");
+    json.string_value("normalized");
+    json.key("scenes");
+    json.begin_array();
+    for (const auto &scene : snapshot.scenes) {
+        json.begin_object();
+        json.key("id");
+        json.uint_value(scene->id);
+        json.key("items");
+        json.begin_array();
+        for (const SceneItemState &item : scene->items) {
+            if (listed.count(item.source) == 0) continue;
+            json.begin_object();
+            json.key("source");
+            json.uint_value(item.source);
+            json.key("visible");
+            json.bool_value(item.visible);
+            json.end_object();
+        }
+        json.end_array();
+        json.key("name");
+        json.string_value(scene->name);
+        json.end_object();
+    }
+    json.end_array();
+    json.key("sourceFlags");
+    json.begin_object();
+    for (const auto &entry : kSourceFlagNames) {
+        json.key(entry.name);
+        json.uint_value(entry.flag);
+        known_flags |= entry.flag;
+    }
+    json.end_object();
+    json.key("sources");
+    json.begin_array();
+    for (const SourceState *source : sources) {
+        json.begin_object();
+        json.key("filters");
+        json.begin_array();
+        for (const FilterState &filter : source->filters) {
+            json.begin_object();
+            json.key("enabled");
+            json.bool_value(filter.enabled);
+            json.key("id");
+            json.uint_value(filter.id);
+            json.key("name");
+            json.string_value(filter.name);
+            json.end_object();
+        }
+        json.end_array();
+        json.key("flags");
+        json.uint_value(source->output_flags & known_flags);
+        json.key("id");
+        json.uint_value(source->id);
+        json.key("name");
+        json.string_value(source->name);
+        json.end_object();
+    }
+    json.end_array();
+    json.key("version");
+    json.uint_value(snapshot.graph_version);
+    json.end_object();
+}
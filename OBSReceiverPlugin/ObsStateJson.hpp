@@ -0,0 +1,32 @@
+// ObsStateJson.hpp
+#pragma once
+
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "SceneModel.hpp"
+
+// The /obsState documents, built from a scene model snapshot so serving them
+// never touches OBS. Ids are NameIds, which a command may use as "#<id>" in
+// place of the name; "version" is the scene_graph_version() they belong to.
+
+// The default document as an nlohmann value. The server writes the same bytes
+// with write_obs_state(); this one is kept as its reference.
+nlohmann::json build_obs_state(const SceneGraphSnapshot &snapshot);
+
+// Appends the default document to out, straight through a JsonWriter and with
+// the same bytes build_obs_state(snapshot).dump() would give: keys sorted,
+// items without a known source left out.
+void write_obs_state(const SceneGraphSnapshot &snapshot, std::string &out);
+
+// Appends the ?format=normalized document to out; its layout is described
+// with ObsStateFormat in StateReader.cpp.
+void write_normalized_obs_state(const SceneGraphSnapshot &snapshot, std::string &out);
+
+// A JSON Patch (RFC 6902) turning the default document of from into that of
+// to. Nodes shared between the two snapshots compare by pointer, so an
+// unchanged graph costs a walk over its items and nothing else. Scenes that
+// were removed or appended get their own op, a renamed scene gets its id and
+// name replaced; anything else that moves scenes around replaces them all.
+nlohmann::json::array_t diff_obs_state(const SceneGraphSnapshot &from, const SceneGraphSnapshot &to);
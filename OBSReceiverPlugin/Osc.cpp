@@ -0,0 +1,199 @@
+// Osc.cpp
+#include "Osc.hpp"
+#include "CommandTable.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+
+namespace {
+
+constexpr int kMaxBundleDepth = 4;
+constexpr size_t kMaxOscArgs = 16;
+
+class OscReader {
+public:
+    OscReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+    bool at_end() const { return pos_ >= size_; }
+
+    // OSC strings are NUL-terminated and padded to a multiple of 4 bytes.
+    bool read_string(std::string_view& out) {
+        if (pos_ >= size_) return false;
+        const void* nul = std::memchr(data_ + pos_, '\0', size_ - pos_);
+        if (!nul) return false;
+
+        const size_t len = static_cast<const char*>(nul) - (data_ + pos_);
+        out = std::string_view(data_ + pos_, len);
+        return skip(padded(len + 1));
+    }
+
+    bool read_i32(int32_t& out) {
+        if (size_ - pos_ < 4) return false;
+        const auto* p = reinterpret_cast<const unsigned char*>(data_ + pos_);
+        out = static_cast<int32_t>((uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+                                   (uint32_t(p[2]) << 8) | uint32_t(p[3]));
+        pos_ += 4;
+        return true;
+    }
+
+    bool read_blob(const char*& out, size_t& len) {
+        int32_t n = 0;
+        if (!read_i32(n) || n < 0 || static_cast<size_t>(n) > size_ - pos_) return false;
+        out = data_ + pos_;
+        len = static_cast<size_t>(n);
+        return skip(padded(len));
+    }
+
+    bool skip(size_t n) {
+        if (n > size_ - pos_) return false;
+        pos_ += n;
+        return true;
+    }
+
+private:
+    static size_t padded(size_t n) { return (n + 3) & ~size_t(3); }
+
+    const char* data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+const CommandDef* find_command(std::string_view address) {
+    const size_t slash = address.rfind('/');
+    return find_command_def(slash == std::string_view::npos ? address : address.substr(slash + 1));
+}
+
+// Splits on newlines so one argument may carry several event lines.
+bool emit_raw_lines(std::string_view text, const OscLineSink& emit) {
+    while (!text.empty()) {
+        const size_t nl = text.find('\n');
+        std::string_view line = text.substr(0, nl);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (!line.empty() && !emit(line)) return false;
+        if (nl == std::string_view::npos) break;
+        text.remove_prefix(nl + 1);
+    }
+    return true;
+}
+
+struct DecodeContext {
+    std::string& scratch;
+    const OscLineSink& emit;
+    bool stopped = false;
+};
+
+bool decode_message(OscReader& reader, std::string_view address, DecodeContext& ctx) {
+    std::string_view tags;
+    if (!reader.read_string(tags) || tags.empty() || tags.front() != ',') return false;
+    tags.remove_prefix(1);
+
+    // String arguments are views into the packet; integers are formatted into
+    // int_text. Anything past kMaxOscArgs is ignored.
+    std::string_view args[kMaxOscArgs];
+    char int_text[kMaxOscArgs][12];
+    size_t arg_count = 0;
+
+    for (const char tag : tags) {
+        switch (tag) {
+        case 's':
+        case 'S': {
+            std::string_view value;
+            if (!reader.read_string(value)) return false;
+            if (arg_count < kMaxOscArgs) args[arg_count++] = value;
+            break;
+        }
+        case 'i': {
+            int32_t value = 0;
+            if (!reader.read_i32(value)) return false;
+            if (arg_count < kMaxOscArgs) {
+                const int len = std::snprintf(int_text[arg_count], sizeof(int_text[arg_count]), "%d", value);
+                args[arg_count] = std::string_view(int_text[arg_count], static_cast<size_t>(len));
+                ++arg_count;
+            }
+            break;
+        }
+        case 'f':
+        case 'c':
+        case 'r':
+        case 'm':
+            if (!reader.skip(4)) return false;
+            break;
+        case 'h':
+        case 't':
+        case 'd':
+            if (!reader.skip(8)) return false;
+            break;
+        case 'b': {
+            const char* blob = nullptr;
+            size_t len = 0;
+            if (!reader.read_blob(blob, len)) return false;
+            break;
+        }
+        case 'T':
+        case 'F':
+        case 'N':
+        case 'I':
+            break;
+        default:
+            // Unknown tag: its size is unknown, so the rest can't be parsed.
+            return false;
+        }
+    }
+
+    const CommandDef* command = find_command(address);
+    if (!command) {
+        for (size_t i = 0; i < arg_count && !ctx.stopped; ++i) {
+            ctx.stopped = !emit_raw_lines(args[i], ctx.emit);
+        }
+        return true;
+    }
+
+    std::string& line = ctx.scratch;
+    line.assign(command->name);
+    if (arg_count > 0 && !args[0].empty() && args[0].front() == '-') {
+        for (size_t i = 0; i < arg_count; ++i) {
+            line += ' ';
+            line += args[i];
+        }
+    } else {
+        for (size_t i = 0; i < arg_count && i < command->positional.size(); ++i) {
+            if (command->positional[i] == ArgKey::Count) break;
+            line += " -";
+            line += arg_name(command->positional[i]);
+            line += ' ';
+            line += args[i];
+        }
+    }
+    ctx.stopped = !ctx.emit(line);
+    return true;
+}
+
+bool decode_packet(const char* data, size_t size, DecodeContext& ctx, int depth) {
+    OscReader reader(data, size);
+    std::string_view address;
+    if (!reader.read_string(address)) return false;
+
+    if (address == "#bundle") {
+        if (depth >= kMaxBundleDepth || !reader.skip(8)) return false; // time tag
+        while (!reader.at_end() && !ctx.stopped) {
+            const char* element = nullptr;
+            size_t len = 0;
+            if (!reader.read_blob(element, len) || !decode_packet(element, len, ctx, depth + 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (address.empty() || address.front() != '/') return false;
+    return decode_message(reader, address, ctx);
+}
+
+} // namespace
+
+bool decode_osc_packet(const char* data, size_t size, std::string& scratch, const OscLineSink& emit) {
+    DecodeContext ctx{scratch, emit};
+    return decode_packet(data, size, ctx, 0);
+}
@@ -0,0 +1,23 @@
+// Osc.hpp
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Returning false stops decoding the rest of the packet.
+using OscLineSink = std::function<bool(std::string_view line)>;
+
+// Decodes an OSC 1.0 packet (message or bundle) into event lines understood by
+// process_event and hands each to emit. Lines are built in scratch, which is
+// reused between calls. Returns false if the packet is malformed.
+//
+// An address whose last component is a command name maps onto that command:
+//   /show_source "Scene" "Source"      -> show_source -scene_name Scene -source_name Source
+//   /obs/toggle_filter "Source" "Blur" -> toggle_filter -source_name Source -filter_name Blur
+//   /switch_scene "Scene"              -> switch_scene -scene_name Scene
+// Arguments that already start with '-' are passed through as "-key value"
+// pairs instead. Any other address (e.g. the orchestrator's "/trigger") treats
+// each string argument as a raw event line.
+bool decode_osc_packet(const char* data, size_t size, std::string& scratch, const OscLineSink& emit);
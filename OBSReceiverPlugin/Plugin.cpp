@@ -6,13 +6,29 @@
 #endif
 
 #include <obs-module.h>
+#include <util/platform.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 #include "Channel.hpp"
+#include "CommandTable.hpp"
+#include "Config.hpp"
+#include "LineFraming.hpp"
 #include "ObsEvents.hpp"
+#include "SceneModel.hpp"
+#include "SourceCache.hpp"
+#ifdef __linux__
+#include "Listener.hpp"
+#include "ShmEventRing.hpp"
+#endif
 #include "StateReader.hpp"
 
 OBS_DECLARE_MODULE()
@@ -42,22 +58,172 @@ static SOCKET g_listener_socket = INVALID_SOCKET;
 static SOCKET g_client_socket = INVALID_SOCKET;
 #endif
 
-StringChannel g_event_channel;
+static std::unique_ptr<EventChannel> g_event_channel;
+static PluginConfig g_config;
+
+static void dispatch_task(void *param);
+
+// Immediate dispatch: set while a dispatch_task is queued, so a burst of lines
+// costs one graphics task instead of one per line.
+static std::atomic<bool> g_dispatch_enabled{false};
+static std::atomic<bool> g_dispatch_queued{false};
+// How long unload gives a queued dispatch_task to run before going ahead.
+static constexpr std::chrono::milliseconds kDispatchDrainTimeout{250};
+// dispatch_tasks that have started and not returned yet; unload waits for
+// them before tearing anything down.
+static std::atomic<int> g_dispatch_running{0};
+
+// Runs on the ingest threads: lines and binary frames are parsed here and only
+// the resulting commands are queued, so the tick never tokenizes. Returns false
+// once the channel is closed and the listener should stop.
+static bool publish_event(EventMessage message, MessageFormat format, uint16_t origin)
+{
+    thread_local std::vector<EventCommand> commands;
+    commands.clear();
+    if (format == MessageFormat::End) {
+        end_event_origin(origin, commands);
+    } else if (format == MessageFormat::Frame) {
+        parse_event_frame(message.view(), origin, commands);
+    } else {
+        parse_event_line(message.view(), origin, commands);
+    }
+    for (const EventCommand& command : commands) {
+        // Dropped by the overflow policy; counted in the channel stats.
+        if (!g_event_channel->push(command) && g_event_channel->is_closed()) {
+            return false;
+        }
+    }
+
+    if (!commands.empty() && g_dispatch_enabled.load(std::memory_order_acquire) &&
+        !g_dispatch_queued.exchange(true, std::memory_order_acq_rel)) {
+        obs_queue_task(OBS_TASK_GRAPHICS, dispatch_task, nullptr, false);
+    }
+    return true;
+}
+
+// The batch currently being executed. Only touched from the tick thread.
+static EventBatch g_tick_batch;
+// Per lane: time from parsing a command to taking it into a batch. Logged on
+// unload next to the channel's own depth.
+static std::array<LatencyHistogram, kLaneCount> g_lane_wait;
+#ifdef __linux__
+static ShmEventReader g_shm_reader;
+static uint16_t g_shm_origin = 0;
+static std::vector<EventCommand> g_shm_commands;
+// Parsed from shared memory but not yet batched, per lane. The ring is only
+// read while these hold less than a tick's budget, so they stay small.
+static std::array<std::deque<EventCommand>, kLaneCount> g_shm_pending;
+#endif
+// Time spent running batches and commands executed there, logged on unload.
+static uint64_t g_tick_ns = 0;
+static uint64_t g_tick_commands = 0;
+
+// The next command for lane: left over from shared memory, else from the
+// channel. Whatever is not taken stays in the channel's ring.
+static bool next_pending(Lane lane, EventCommand& out)
+{
+#ifdef __linux__
+    std::deque<EventCommand>& queue = g_shm_pending[static_cast<size_t>(lane)];
+    if (!queue.empty()) {
+        out = queue.front();
+        queue.pop_front();
+        return true;
+    }
+#endif
+    return g_event_channel->try_pop(lane, out);
+}
+
+// Graphics thread only: from the tick, or from a dispatch_task, which OBS also
+// runs on the graphics thread.
+static void run_pending_events()
+{
+    const auto start = std::chrono::steady_clock::now();
+    const TickDrainBudget& budget = g_config.tick_drain;
+
+    if (g_tick_batch.empty()) {
+        g_tick_batch.clear();
+#ifdef __linux__
+        // Shared memory has no ingest thread of its own, so its lines are
+        // parsed here. Anything we leave behind stays in the ring; a full ring
+        // makes the sender fall back to TCP.
+        const size_t pending = g_shm_pending[0].size() + g_shm_pending[1].size();
+        if (pending < budget.max_events) {
+            g_shm_reader.drain(budget.max_events - pending, [](std::string_view line) {
+                g_shm_commands.clear();
+                parse_event_line(line, g_shm_origin, g_shm_commands);
+                for (const EventCommand& command : g_shm_commands) {
+                    g_shm_pending[static_cast<size_t>(lane_of(command))].push_back(command);
+                }
+            });
+        }
+#endif
+        const uint64_t now_ns = os_gettime_ns();
+        // Units still open from earlier ticks stay in the batch; only commands
+        // that complete a unit become executable. The high lane gets the
+        // budget first and the normal lane whatever it leaves. Stale commands
+        // are dropped without using up any of it, so a backlog left by a
+        // hitch is cleared in one go.
+        size_t added = 0;
+        EventCommand command;
+        for (const Lane lane : {Lane::High, Lane::Normal}) {
+            while (added < budget.max_events && next_pending(lane, command)) {
+                if (now_ns > command.received_ns) {
+                    g_lane_wait[static_cast<size_t>(lane)].record(now_ns - command.received_ns);
+                }
+                if (g_tick_batch.add(command, now_ns)) {
+                    ++added;
+                }
+            }
+        }
+        // Timed commands fire on the frame closest to their target: this one,
+        // unless the next one will be nearer.
+        g_tick_batch.seal(now_ns, now_ns + obs_get_frame_interval_ns() / 2);
+    }
+
+    if (g_tick_batch.empty()) {
+        return;
+    }
+
+    const auto deadline = start + std::chrono::nanoseconds(budget.max_ns);
+    g_tick_commands += g_tick_batch.execute_until(deadline);
+    g_tick_ns += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
 
 static void tick_callback(void *param, float seconds)
 {
-	    std::string event;
-    while (g_event_channel.pop(event)) {
-	process_event(event);
+    UNUSED_PARAMETER(param);
+    UNUSED_PARAMETER(seconds);
+    // Releases the objects a dropped cache still holds, cues or not.
+    sync_source_cache();
+    // Still needed in immediate mode: timed commands, shared memory and
+    // anything a dispatch_task left over for lack of budget.
+    run_pending_events();
+}
+
+static void dispatch_task(void *param)
+{
+    UNUSED_PARAMETER(param);
+    // Counted before g_dispatch_enabled is read, both sequentially
+    // consistent: either unload sees this task running and waits for it, or
+    // the task sees dispatch disabled and touches nothing.
+    g_dispatch_running.fetch_add(1);
+    // Cleared first, so a line pushed while this runs queues another pass.
+    g_dispatch_queued.store(false, std::memory_order_release);
+    if (g_dispatch_enabled.load()) {
+        run_pending_events();
     }
+    g_dispatch_running.fetch_sub(1);
 }
 
 
 bool obs_module_load(void)
 {
     blog(LOG_INFO, "[hot-cue-mesh] module loaded");
+    g_config = load_plugin_config();
     start_state_reader_server();
-    obs_add_tick_callback(tick_callback, nullptr);
+    start_source_cache();
+    start_scene_model();
 
     if (g_listener_thread.joinable()) {
 #ifdef _WIN32
@@ -77,10 +243,29 @@ bool obs_module_load(void)
 #endif
         g_listener_thread.join();
     }
+#ifdef __linux__
+    stop_event_listener();
+#endif
     g_listener_stop.store(false, std::memory_order_release);
 
-    g_listener_thread = std::thread([]() {
+    g_event_channel = std::make_unique<EventChannel>(g_config.channel);
+    blog(LOG_INFO, "[hot-cue-mesh] event channel capacity %zu per lane, overflow policy %s",
+         g_event_channel->capacity(), overflow_policy_name(g_event_channel->policy()));
+
+    for (const CommandDef& def : kCommandDefs) {
+        const uint64_t ttl_ns = g_config.stale.ttl_ns[static_cast<size_t>(def.type)];
+        g_tick_batch.set_ttl(def.type, ttl_ns);
+        if (ttl_ns > 0) {
+            blog(LOG_INFO, "[hot-cue-mesh] %s expires after %llu ms", def.name.data(),
+                 static_cast<unsigned long long>(ttl_ns / 1'000'000));
+        }
+    }
+    obs_add_tick_callback(tick_callback, nullptr);
+    g_dispatch_enabled.store(g_config.dispatch == DispatchMode::Immediate, std::memory_order_release);
+    blog(LOG_INFO, "[hot-cue-mesh] dispatch mode %s", dispatch_mode_name(g_config.dispatch));
+
 #ifdef _WIN32
+    g_listener_thread = std::thread([]() {
         WSADATA wsa_data{};
         if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
             blog(LOG_ERROR, "[hot-cue-mesh] WSAStartup failed");
@@ -135,7 +320,7 @@ bool obs_module_load(void)
 
         blog(LOG_INFO, "[hot-cue-mesh] listening for hot cue events on 127.0.0.1:%u", kHotCueTcpPort);
 
-        char buffer[4096];
+        const LineSink sink = publish_event;
         while (!g_listener_stop.load(std::memory_order_acquire)) {
             const SOCKET client = accept(listener, nullptr, nullptr);
             if (client == INVALID_SOCKET) {
@@ -153,11 +338,11 @@ bool obs_module_load(void)
             setsockopt(client, SOL_SOCKET, SO_RCVTIMEO,
                        reinterpret_cast<const char*>(&recv_timeout_ms), sizeof(recv_timeout_ms));
 
-            std::string pending_line;
-            pending_line.reserve(256);
+            LineAssembler lines;
 
             while (!g_listener_stop.load(std::memory_order_acquire)) {
-                const int bytes_read = recv(client, buffer, sizeof(buffer), 0);
+                const auto [area, space] = lines.receive_area();
+                const int bytes_read = recv(client, area, static_cast<int>(space), 0);
                 if (bytes_read == 0) {
                     break;
                 }
@@ -169,42 +354,14 @@ bool obs_module_load(void)
                     break;
                 }
 
-                size_t segment_start = 0;
-                for (int i = 0; i < bytes_read; ++i) {
-                    if (buffer[i] != '\n') {
-                        continue;
-                    }
-
-                    pending_line.append(buffer + segment_start, static_cast<size_t>(i) - segment_start);
-                    if (!pending_line.empty() && pending_line.back() == '\r') {
-                        pending_line.pop_back();
-                    }
-
-                    if (!pending_line.empty() && !g_event_channel.push(std::move(pending_line))) {
-                        g_listener_stop.store(true, std::memory_order_release);
-                        break;
-                    }
-
-                    pending_line.clear();
-                    segment_start = static_cast<size_t>(i) + 1;
-                }
-
-                if (g_listener_stop.load(std::memory_order_acquire)) {
+                if (!lines.commit(static_cast<size_t>(bytes_read), sink)) {
+                    g_listener_stop.store(true, std::memory_order_release);
                     break;
                 }
-
-                if (segment_start < static_cast<size_t>(bytes_read)) {
-                    pending_line.append(buffer + segment_start, static_cast<size_t>(bytes_read) - segment_start);
-                }
             }
 
-            if (!g_listener_stop.load(std::memory_order_acquire) && !pending_line.empty()) {
-                if (pending_line.back() == '\r') {
-                    pending_line.pop_back();
-                }
-                if (!pending_line.empty() && !g_event_channel.push(std::move(pending_line))) {
-                    g_listener_stop.store(true, std::memory_order_release);
-                }
+            if (!g_listener_stop.load(std::memory_order_acquire) && !lines.finish(sink)) {
+                g_listener_stop.store(true, std::memory_order_release);
             }
 
             {
@@ -223,10 +380,24 @@ bool obs_module_load(void)
             }
         }
         WSACleanup();
+    });
+#elif defined(__linux__)
+    ListenerOptions listener_options;
+    if (!parse_listener_backend(g_config.listener.backend, listener_options.backend)) {
+        blog(LOG_WARNING, "[hot-cue-mesh] unknown listener backend '%s', using epoll",
+             g_config.listener.backend.c_str());
+    }
+    listener_options.tcp_port = kHotCueTcpPort;
+    listener_options.unix_path = g_config.listener.unix_socket_path;
+    listener_options.udp_port = g_config.listener.udp_port;
+    start_event_listener(listener_options, publish_event);
+    if (!g_config.listener.shm_name.empty()) {
+        g_shm_origin = acquire_message_origin();
+        g_shm_reader.create(g_config.listener.shm_name);
+    }
 #else
-        blog(LOG_WARNING, "[hot-cue-mesh] TCP listener thread is only implemented for Windows builds");
+    blog(LOG_WARNING, "[hot-cue-mesh] TCP listener is only implemented for Windows and Linux builds");
 #endif
-    });
 
     return true;
 }
@@ -252,10 +423,99 @@ void obs_module_unload(void)
             g_listener_socket = INVALID_SOCKET;
         }
     }
+#elif defined(__linux__)
+    stop_event_listener();
 #endif
+    if (g_event_channel) {
+        g_event_channel->close();
+    }
     if (g_listener_thread.joinable()) {
         g_listener_thread.join();
     }
+    // No listener is left to queue a dispatch_task. One that is already
+    // running is waited for, since everything below pulls its state away. One
+    // still queued gets a few frames to run, and then finds dispatch disabled;
+    // it cannot be waited for without limit, as on shutdown the graphics
+    // thread may be gone.
+    g_dispatch_enabled.store(false);
+    const auto queued_deadline = std::chrono::steady_clock::now() + kDispatchDrainTimeout;
+    while (g_dispatch_queued.load(std::memory_order_acquire) &&
+           std::chrono::steady_clock::now() < queued_deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    while (g_dispatch_running.load() != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+#ifdef __linux__
+    for (std::deque<EventCommand>& queue : g_shm_pending) {
+        queue.clear();
+    }
+#endif
+    g_tick_batch.reset();
+    stop_scene_model();
+    stop_source_cache();
+#ifdef __linux__
+    g_shm_reader.destroy();
+    release_message_origin(g_shm_origin);
+    g_shm_origin = 0;
+#endif
+    blog(LOG_INFO, "[hot-cue-mesh] coalesced %zu redundant commands", g_tick_batch.coalesced());
+    for (const CommandDef& def : kCommandDefs) {
+        if (const size_t expired = g_tick_batch.expired(def.type); expired > 0) {
+            blog(LOG_INFO, "[hot-cue-mesh] dropped %zu stale %s commands", expired, def.name.data());
+        }
+    }
+    if (g_tick_batch.forced_commits() > 0) {
+        blog(LOG_INFO, "[hot-cue-mesh] force-committed %zu groups (too large or left open)",
+             g_tick_batch.forced_commits());
+    }
+    if (g_tick_batch.abandoned_groups() > 0) {
+        blog(LOG_INFO, "[hot-cue-mesh] dropped %zu groups whose sender left before committing",
+             g_tick_batch.abandoned_groups());
+    }
+    if (g_tick_commands > 0) {
+        blog(LOG_INFO, "[hot-cue-mesh] tick: %llu commands, %llu ns per command",
+             static_cast<unsigned long long>(g_tick_commands),
+             static_cast<unsigned long long>(g_tick_ns / g_tick_commands));
+    }
+    const LatencyHistogram& latency = apply_latency();
+    if (latency.count() > 0) {
+        blog(LOG_INFO,
+             "[hot-cue-mesh] receive-to-apply latency (%s dispatch): n=%llu p50=%llu us p90=%llu us "
+             "p99=%llu us max=%llu us",
+             dispatch_mode_name(g_config.dispatch), static_cast<unsigned long long>(latency.count()),
+             static_cast<unsigned long long>(latency.quantile_ns(0.50) / 1000),
+             static_cast<unsigned long long>(latency.quantile_ns(0.90) / 1000),
+             static_cast<unsigned long long>(latency.quantile_ns(0.99) / 1000),
+             static_cast<unsigned long long>(latency.max_ns() / 1000));
+    }
+    blog(LOG_INFO, "[hot-cue-mesh] %zu interned names", interned_name_count());
+    const SourceCacheStats cache_stats = source_cache_stats();
+    blog(LOG_INFO, "[hot-cue-mesh] source cache: hits=%llu misses=%llu invalidations=%llu",
+         static_cast<unsigned long long>(cache_stats.hits),
+         static_cast<unsigned long long>(cache_stats.misses),
+         static_cast<unsigned long long>(cache_stats.invalidations));
+
+    if (g_event_channel) {
+        const ChannelStats stats = g_event_channel->stats();
+        for (size_t lane = 0; lane < kLaneCount; ++lane) {
+            const LaneStats& lane_stats = stats.lanes[lane];
+            const LatencyHistogram& wait = g_lane_wait[lane];
+            blog(LOG_INFO,
+                 "[hot-cue-mesh] event channel, %s lane: accepted=%llu dropped=%llu coalesced=%llu "
+                 "high_water=%zu wait p50=%llu us p99=%llu us max=%llu us",
+                 lane_name(static_cast<Lane>(lane)), static_cast<unsigned long long>(lane_stats.accepted),
+                 static_cast<unsigned long long>(lane_stats.dropped),
+                 static_cast<unsigned long long>(lane_stats.coalesced), lane_stats.high_water,
+                 static_cast<unsigned long long>(wait.quantile_ns(0.50) / 1000),
+                 static_cast<unsigned long long>(wait.quantile_ns(0.99) / 1000),
+                 static_cast<unsigned long long>(wait.max_ns() / 1000));
+        }
+    }
+    const MessageSlabStats slab_stats = message_slab_stats();
+    blog(LOG_INFO, "[hot-cue-mesh] message slabs: pooled=%llu heap=%llu",
+         static_cast<unsigned long long>(slab_stats.pooled_acquires),
+         static_cast<unsigned long long>(slab_stats.heap_fallbacks));
 
     blog(LOG_INFO, "[hot-cue-mesh] module unloaded");
 }
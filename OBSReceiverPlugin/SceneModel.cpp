@@ -0,0 +1,509 @@
+// SceneModel.cpp
+#include "SceneModel.hpp"
+#include "SourceCache.hpp"
+
+#include <obs-frontend-api.h>
+#include <obs-module.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace {
+
+using SourceMap = std::unordered_map<NameId, std::shared_ptr<const SourceState>>;
+
+// The writers' copy. Only touched with g_mutex held, and no OBS function is
+// called with g_mutex held: handlers read what they need first, then apply it.
+struct Model {
+    uint64_t revision = 0;
+    std::vector<std::shared_ptr<const SceneState>> scenes;
+    SourceMap sources;
+};
+
+std::mutex g_mutex;
+// Notified with every commit().
+std::condition_variable g_changed;
+Model g_model;
+// g_model.revision, for the lock-free check in scene_graph_snapshot().
+std::atomic<uint64_t> g_revision{0};
+// Only through std::atomic_load/std::atomic_store.
+std::shared_ptr<const SceneGraphSnapshot> g_published;
+std::atomic<bool> g_started{false};
+// From SCENE_COLLECTION_CHANGING until the collection is loaded: the model is
+// rebuilt then anyway, so handlers leave it alone instead of patching it once
+// per loaded item.
+std::atomic<bool> g_loading{false};
+
+// What a change may affect besides the model itself.
+enum class Change : uint8_t {
+    State,   // visibility, filter state, order: nothing the source cache holds
+    Lookups, // what a name resolves to (filters, inputs), so the source cache
+    Graph,   // scenes or scene items added, removed or renamed; moves
+             // scene_graph_version() as well
+};
+
+// With g_mutex held, after changing g_model. Dropping the source cache (and
+// moving scene_graph_version()) under g_mutex keeps every snapshot's
+// graph_version in step with its contents.
+void commit(Change change) {
+    if (change == Change::Graph) {
+        invalidate_scene_graph();
+    } else if (change == Change::Lookups) {
+        invalidate_source_cache();
+    }
+    g_revision.store(++g_model.revision, std::memory_order_release);
+    g_changed.notify_all();
+}
+
+void touch(Change change) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    commit(change);
+}
+
+NameId name_id(const obs_source_t* source) {
+    const char* name = source ? obs_source_get_name(source) : nullptr;
+    NameId id = kNoName;
+    return name && intern_name(name, id) ? id : kNoName;
+}
+
+std::vector<std::shared_ptr<const SceneState>>::iterator find_scene(NameId id) {
+    return std::find_if(g_model.scenes.begin(), g_model.scenes.end(),
+                        [id](const std::shared_ptr<const SceneState>& scene) { return scene->id == id; });
+}
+
+void on_filter_enable(void*, calldata_t* cd);
+
+void read_filter(obs_source_t*, obs_source_t* filter, void* param) {
+    auto* filters = static_cast<std::vector<FilterState>*>(param);
+    FilterState state;
+    state.id = name_id(filter);
+    if (state.id == kNoName) return;
+    state.name = name_view(state.id);
+    state.enabled = obs_source_enabled(filter);
+    filters->push_back(std::move(state));
+}
+
+std::vector<FilterState> read_filters(obs_source_t* source) {
+    std::vector<FilterState> filters;
+    obs_source_enum_filters(source, read_filter, &filters);
+    return filters;
+}
+
+std::shared_ptr<const SourceState> read_source(obs_source_t* source, NameId id) {
+    auto state = std::make_shared<SourceState>();
+    state->id = id;
+    state->name = name_view(id);
+    state->output_flags = obs_source_get_output_flags(source);
+    state->filters = read_filters(source);
+    return state;
+}
+
+void connect_filter(obs_source_t*, obs_source_t* filter, void*) {
+    signal_handler_connect(obs_source_get_signal_handler(filter), "enable", on_filter_enable, nullptr);
+}
+
+void disconnect_filter(obs_source_t*, obs_source_t* filter, void*) {
+    signal_handler_disconnect(obs_source_get_signal_handler(filter), "enable", on_filter_enable, nullptr);
+}
+
+void on_filter_add(void*, calldata_t* cd);
+void on_filter_remove(void*, calldata_t* cd);
+void on_reorder_filters(void*, calldata_t* cd);
+
+// Sources that appear as scene items. OBS ignores a second connect of the same
+// callback, so watching a source twice is harmless.
+void watch_source(obs_source_t* source) {
+    signal_handler_t* handler = obs_source_get_signal_handler(source);
+    signal_handler_connect(handler, "filter_add", on_filter_add, nullptr);
+    signal_handler_connect(handler, "filter_remove", on_filter_remove, nullptr);
+    signal_handler_connect(handler, "reorder_filters", on_reorder_filters, nullptr);
+    obs_source_enum_filters(source, connect_filter, nullptr);
+}
+
+void unwatch_source(obs_source_t* source) {
+    signal_handler_t* handler = obs_source_get_signal_handler(source);
+    signal_handler_disconnect(handler, "filter_add", on_filter_add, nullptr);
+    signal_handler_disconnect(handler, "filter_remove", on_filter_remove, nullptr);
+    signal_handler_disconnect(handler, "reorder_filters", on_reorder_filters, nullptr);
+    obs_source_enum_filters(source, disconnect_filter, nullptr);
+}
+
+struct SceneRead {
+    SceneState* scene;
+    // When set, the source of every item is read into it, unless already there.
+    SourceMap* sources;
+};
+
+bool read_scene_item(obs_scene_t*, obs_sceneitem_t* item, void* param) {
+    auto* read = static_cast<SceneRead*>(param);
+    obs_source_t* source = obs_sceneitem_get_source(item);
+    const NameId id = name_id(source);
+    if (id == kNoName) return true;
+
+    SceneItemState state;
+    state.item_id = obs_sceneitem_get_id(item);
+    state.source = id;
+    state.visible = obs_sceneitem_visible(item);
+    read->scene->items.push_back(state);
+
+    if (read->sources && read->sources->count(id) == 0) {
+        watch_source(source);
+        read->sources->emplace(id, read_source(source, id));
+    }
+    return true;
+}
+
+std::shared_ptr<SceneState> read_scene(obs_source_t* scene_source, SourceMap* sources) {
+    auto scene = std::make_shared<SceneState>();
+    scene->id = name_id(scene_source);
+    scene->name = name_view(scene->id);
+    SceneRead read{scene.get(), sources};
+    obs_scene_enum_items(obs_scene_from_source(scene_source), read_scene_item, &read);
+    return scene;
+}
+
+void on_item_add(void*, calldata_t* cd);
+void on_item_remove(void*, calldata_t* cd);
+void on_reorder(void*, calldata_t* cd);
+void on_item_visible(void*, calldata_t* cd);
+
+// Scenes and groups. Groups are not modelled, but the source cache looks into
+// them, so their item changes still count as scene graph changes.
+void connect_scene_signals(obs_source_t* scene_source) {
+    signal_handler_t* handler = obs_source_get_signal_handler(scene_source);
+    signal_handler_connect(handler, "item_add", on_item_add, nullptr);
+    signal_handler_connect(handler, "item_remove", on_item_remove, nullptr);
+    signal_handler_connect(handler, "reorder", on_reorder, nullptr);
+    signal_handler_connect(handler, "item_visible", on_item_visible, nullptr);
+}
+
+void disconnect_scene_signals(obs_source_t* scene_source) {
+    signal_handler_t* handler = obs_source_get_signal_handler(scene_source);
+    signal_handler_disconnect(handler, "item_add", on_item_add, nullptr);
+    signal_handler_disconnect(handler, "item_remove", on_item_remove, nullptr);
+    signal_handler_disconnect(handler, "reorder", on_reorder, nullptr);
+    signal_handler_disconnect(handler, "item_visible", on_item_visible, nullptr);
+}
+
+void clear_model() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_model.scenes.clear();
+    g_model.sources.clear();
+    commit(Change::Graph);
+}
+
+// obs_enum_scenes() also visits groups.
+bool rebuild_scene(void* param, obs_source_t* scene_source) {
+    auto* model = static_cast<Model*>(param);
+    connect_scene_signals(scene_source);
+    if (obs_scene_from_source(scene_source)) {
+        std::shared_ptr<SceneState> scene = read_scene(scene_source, &model->sources);
+        if (scene->id != kNoName) model->scenes.push_back(std::move(scene));
+    }
+    return true;
+}
+
+void rebuild_model() {
+    Model next;
+    obs_enum_scenes(rebuild_scene, &next);
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_model.scenes = std::move(next.scenes);
+    g_model.sources = std::move(next.sources);
+    commit(Change::Graph);
+}
+
+// Re-reads the item list of a scene already in the model, and the source of
+// an added item. Other item sources are in the model already: they got there
+// when their item was added.
+void refresh_scene(obs_scene_t* scene, obs_source_t* added, Change change) {
+    obs_source_t* scene_source = scene ? obs_scene_get_source(scene) : nullptr;
+    if (g_loading.load(std::memory_order_acquire) || !scene_source || !obs_scene_from_source(scene_source)) {
+        if (change != Change::State) touch(change);
+        return;
+    }
+
+    std::shared_ptr<const SceneState> state = read_scene(scene_source, nullptr);
+    const NameId added_id = name_id(added);
+    std::shared_ptr<const SourceState> added_state;
+    if (added_id != kNoName) {
+        watch_source(added);
+        added_state = read_source(added, added_id);
+    }
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    // Not there if the scene was removed; it still signals while it empties.
+    const auto it = find_scene(state->id);
+    if (it != g_model.scenes.end()) *it = std::move(state);
+    if (added_state) g_model.sources[added_id] = std::move(added_state);
+    commit(change);
+}
+
+void on_item_add(void*, calldata_t* cd) {
+    auto* scene = static_cast<obs_scene_t*>(calldata_ptr(cd, "scene"));
+    auto* item = static_cast<obs_sceneitem_t*>(calldata_ptr(cd, "item"));
+    refresh_scene(scene, item ? obs_sceneitem_get_source(item) : nullptr, Change::Graph);
+}
+
+void on_reorder(void*, calldata_t* cd) {
+    refresh_scene(static_cast<obs_scene_t*>(calldata_ptr(cd, "scene")), nullptr, Change::State);
+}
+
+// Signalled before the item is detached, so re-reading the scene would still
+// find it.
+void on_item_remove(void*, calldata_t* cd) {
+    auto* scene = static_cast<obs_scene_t*>(calldata_ptr(cd, "scene"));
+    auto* item = static_cast<obs_sceneitem_t*>(calldata_ptr(cd, "item"));
+    const NameId scene_id = scene ? name_id(obs_scene_get_source(scene)) : kNoName;
+    const int64_t item_id = item ? obs_sceneitem_get_id(item) : 0;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const auto it = find_scene(scene_id);
+    if (item && it != g_model.scenes.end()) {
+        auto next = std::make_shared<SceneState>(**it);
+        next->items.erase(std::remove_if(next->items.begin(), next->items.end(),
+                                         [item_id](const SceneItemState& s) { return s.item_id == item_id; }),
+                          next->items.end());
+        *it = std::move(next);
+    }
+    commit(Change::Graph);
+}
+
+void on_item_visible(void*, calldata_t* cd) {
+    auto* scene = static_cast<obs_scene_t*>(calldata_ptr(cd, "scene"));
+    auto* item = static_cast<obs_sceneitem_t*>(calldata_ptr(cd, "item"));
+    if (!scene || !item) return;
+    const NameId scene_id = name_id(obs_scene_get_source(scene));
+    const int64_t item_id = obs_sceneitem_get_id(item);
+    const bool visible = calldata_bool(cd, "visible");
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const auto it = find_scene(scene_id);
+    if (it == g_model.scenes.end()) return;
+    const std::vector<SceneItemState>& items = (*it)->items;
+    const auto found = std::find_if(items.begin(), items.end(),
+                                    [item_id](const SceneItemState& s) { return s.item_id == item_id; });
+    if (found == items.end() || found->visible == visible) return;
+
+    auto next = std::make_shared<SceneState>(**it);
+    next->items[found - items.begin()].visible = visible;
+    *it = std::move(next);
+    commit(Change::State);
+}
+
+void refresh_filters(obs_source_t* source, Change change) {
+    const NameId id = g_loading.load(std::memory_order_acquire) ? kNoName : name_id(source);
+    if (id == kNoName) {
+        if (change != Change::State) touch(change);
+        return;
+    }
+    std::vector<FilterState> filters = read_filters(source);
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const auto it = g_model.sources.find(id);
+    if (it != g_model.sources.end()) {
+        auto next = std::make_shared<SourceState>(*it->second);
+        next->filters = std::move(filters);
+        it->second = std::move(next);
+    } else if (change == Change::State) {
+        return;
+    }
+    commit(change);
+}
+
+void on_filter_add(void*, calldata_t* cd) {
+    auto* filter = static_cast<obs_source_t*>(calldata_ptr(cd, "filter"));
+    if (filter) connect_filter(nullptr, filter, nullptr);
+    refresh_filters(static_cast<obs_source_t*>(calldata_ptr(cd, "source")), Change::Lookups);
+}
+
+void on_filter_remove(void*, calldata_t* cd) {
+    auto* filter = static_cast<obs_source_t*>(calldata_ptr(cd, "filter"));
+    if (filter) disconnect_filter(nullptr, filter, nullptr);
+    refresh_filters(static_cast<obs_source_t*>(calldata_ptr(cd, "source")), Change::Lookups);
+}
+
+void on_reorder_filters(void*, calldata_t* cd) {
+    refresh_filters(static_cast<obs_source_t*>(calldata_ptr(cd, "source")), Change::State);
+}
+
+void on_filter_enable(void*, calldata_t* cd) {
+    auto* filter = static_cast<obs_source_t*>(calldata_ptr(cd, "source"));
+    if (!filter) return;
+    const NameId source_id = name_id(obs_filter_get_parent(filter));
+    const NameId filter_id = name_id(filter);
+    const bool enabled = calldata_bool(cd, "enabled");
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const auto it = g_model.sources.find(source_id);
+    if (it == g_model.sources.end()) return;
+    const std::vector<FilterState>& filters = it->second->filters;
+    const auto found = std::find_if(filters.begin(), filters.end(),
+                                    [filter_id](const FilterState& f) { return f.id == filter_id; });
+    if (found == filters.end() || found->enabled == enabled) return;
+
+    auto next = std::make_shared<SourceState>(*it->second);
+    next->filters[found - filters.begin()].enabled = enabled;
+    it->second = std::move(next);
+    commit(Change::State);
+}
+
+// Scenes appear empty; their items follow through item_add. Nothing resolves
+// to a new input or filter before it is added to a scene or source, which
+// signals on its own, so those are left alone.
+void on_source_create(void*, calldata_t* cd) {
+    auto* source = static_cast<obs_source_t*>(calldata_ptr(cd, "source"));
+    if (!source) return;
+    const bool is_scene = obs_scene_from_source(source) != nullptr;
+    if (!is_scene && !obs_group_from_source(source)) return;
+
+    connect_scene_signals(source);
+    if (!is_scene || g_loading.load(std::memory_order_acquire)) {
+        touch(Change::Graph);
+        return;
+    }
+
+    SourceMap sources;
+    std::shared_ptr<const SceneState> scene = read_scene(source, &sources);
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (scene->id != kNoName && find_scene(scene->id) == g_model.scenes.end()) {
+        g_model.scenes.push_back(std::move(scene));
+    }
+    g_model.sources.insert(sources.begin(), sources.end());
+    commit(Change::Graph);
+}
+
+// source_remove takes a scene out of the list; the sources of its items stay
+// until they are destroyed. Any other source only needs the cache dropped.
+void on_source_remove(void*, calldata_t* cd) {
+    auto* source = static_cast<obs_source_t*>(calldata_ptr(cd, "source"));
+    const NameId id = source && obs_scene_from_source(source) ? name_id(source) : kNoName;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const auto it = find_scene(id);
+    if (it == g_model.scenes.end()) {
+        invalidate_source_cache();
+        return;
+    }
+    g_model.scenes.erase(it);
+    commit(Change::Graph);
+}
+
+void on_source_destroy(void*, calldata_t* cd) {
+    auto* source = static_cast<obs_source_t*>(calldata_ptr(cd, "source"));
+    // Filter names are only unique per parent, so a filter's name may also
+    // be a source's.
+    const enum obs_source_type type = source ? obs_source_get_type(source) : OBS_SOURCE_TYPE_FILTER;
+    const bool modelled = type == OBS_SOURCE_TYPE_INPUT || type == OBS_SOURCE_TYPE_SCENE;
+    const NameId id = modelled ? name_id(source) : kNoName;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const auto it = find_scene(id);
+    if (it != g_model.scenes.end()) {
+        g_model.scenes.erase(it);
+        g_model.sources.erase(id);
+        commit(Change::Graph);
+    } else if (g_model.sources.erase(id) > 0) {
+        commit(Change::Lookups);
+    } else {
+        invalidate_source_cache();
+    }
+}
+
+// Ids are names, so a rename changes them wherever the source appears.
+void on_source_rename(void*, calldata_t*) {
+    if (g_loading.load(std::memory_order_acquire)) {
+        touch(Change::Graph);
+        return;
+    }
+    rebuild_model();
+}
+
+void on_frontend_event(enum obs_frontend_event event, void*) {
+    switch (event) {
+    case OBS_FRONTEND_EVENT_SCENE_COLLECTION_CHANGING:
+        g_loading.store(true, std::memory_order_release);
+        clear_model();
+        break;
+    case OBS_FRONTEND_EVENT_SCENE_COLLECTION_CLEANUP:
+        clear_model();
+        break;
+    case OBS_FRONTEND_EVENT_SCENE_COLLECTION_CHANGED:
+    case OBS_FRONTEND_EVENT_FINISHED_LOADING:
+        g_loading.store(false, std::memory_order_release);
+        rebuild_model();
+        break;
+    default:
+        break;
+    }
+}
+
+bool unwatch_scene(void*, obs_source_t* scene_source) {
+    disconnect_scene_signals(scene_source);
+    unwatch_source(scene_source);
+    return true;
+}
+
+bool unwatch_input(void*, obs_source_t* source) {
+    unwatch_source(source);
+    return true;
+}
+
+} // namespace
+
+void start_scene_model() {
+    if (g_started.exchange(true)) return;
+
+    signal_handler_t* handler = obs_get_signal_handler();
+    signal_handler_connect(handler, "source_create", on_source_create, nullptr);
+    signal_handler_connect(handler, "source_remove", on_source_remove, nullptr);
+    signal_handler_connect(handler, "source_destroy", on_source_destroy, nullptr);
+    signal_handler_connect(handler, "source_rename", on_source_rename, nullptr);
+    obs_frontend_add_event_callback(on_frontend_event, nullptr);
+    rebuild_model();
+}
+
+void stop_scene_model() {
+    if (!g_started.exchange(false)) return;
+
+    obs_frontend_remove_event_callback(on_frontend_event, nullptr);
+    signal_handler_t* handler = obs_get_signal_handler();
+    signal_handler_disconnect(handler, "source_create", on_source_create, nullptr);
+    signal_handler_disconnect(handler, "source_remove", on_source_remove, nullptr);
+    signal_handler_disconnect(handler, "source_destroy", on_source_destroy, nullptr);
+    signal_handler_disconnect(handler, "source_rename", on_source_rename, nullptr);
+    obs_enum_scenes(unwatch_scene, nullptr);
+    obs_enum_sources(unwatch_input, nullptr);
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_model.scenes.clear();
+    g_model.sources.clear();
+    std::atomic_store(&g_published, std::shared_ptr<const SceneGraphSnapshot>());
+}
+
+std::shared_ptr<const SceneGraphSnapshot> scene_graph_snapshot() {
+    std::shared_ptr<const SceneGraphSnapshot> snapshot = std::atomic_load(&g_published);
+    if (snapshot && snapshot->revision == g_revision.load(std::memory_order_acquire)) return snapshot;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    snapshot = std::atomic_load(&g_published);
+    if (snapshot && snapshot->revision == g_model.revision) return snapshot;
+
+    auto next = std::make_shared<SceneGraphSnapshot>();
+    next->revision = g_model.revision;
+    next->graph_version = scene_graph_version();
+    next->scenes = g_model.scenes;
+    next->sources = g_model.sources;
+    snapshot = std::move(next);
+    std::atomic_store(&g_published, snapshot);
+    return snapshot;
+}
+
+uint64_t wait_for_scene_model_change(uint64_t revision, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    g_changed.wait_for(lock, timeout, [revision] { return g_model.revision != revision; });
+    return g_model.revision;
+}
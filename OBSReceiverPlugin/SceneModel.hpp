@@ -0,0 +1,74 @@
+// SceneModel.hpp
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "NameTable.hpp"
+
+// A shadow of the OBS scene graph (scenes, their top-level items, item
+// visibility, and the filters on item sources), kept up to date from OBS
+// signals so that /obsState never has to walk OBS itself.
+//
+// Structural changes (a scene or item added or removed, items reordered,
+// filters added, removed or reordered) re-read the one scene or source they
+// affect; item_visible and filter enable only flip a flag. Renames and scene
+// collection changes rebuild the whole model. The model is also the only
+// subscriber to the graph signals: it invalidates the source cache (see
+// SourceCache.hpp) from the same handlers, and moves scene_graph_version()
+// when scenes or scene items are added, removed or renamed, so a snapshot and
+// the version it carries always agree. Inputs and filters coming and going
+// only drop the cache.
+//
+// Nodes are immutable and shared between snapshots; a change copies only the
+// node it touches. Readers get a snapshot through one atomic load, and never
+// touch OBS objects.
+
+struct FilterState {
+    NameId id = kNoName;
+    std::string name;
+    bool enabled = false;
+};
+
+struct SourceState {
+    NameId id = kNoName;
+    std::string name;
+    uint32_t output_flags = 0;
+    std::vector<FilterState> filters;
+};
+
+struct SceneItemState {
+    int64_t item_id = 0;
+    NameId source = kNoName; // key into SceneGraphSnapshot::sources
+    bool visible = false;
+};
+
+struct SceneState {
+    NameId id = kNoName;
+    std::string name;
+    std::vector<SceneItemState> items; // bottom to top, as OBS lists them
+};
+
+struct SceneGraphSnapshot {
+    uint64_t revision = 0;      // changes with every change to the model
+    uint64_t graph_version = 0; // scene_graph_version() for these ids
+    std::vector<std::shared_ptr<const SceneState>> scenes;
+    std::unordered_map<NameId, std::shared_ptr<const SourceState>> sources;
+};
+
+// Call on the UI thread, after start_source_cache().
+void start_scene_model();
+void stop_scene_model();
+
+// The current state. Lock-free unless the model changed since the last call,
+// in which case a new snapshot is published first (copying node pointers, no
+// OBS calls). Thread-safe.
+std::shared_ptr<const SceneGraphSnapshot> scene_graph_snapshot();
+
+// Blocks until the model's revision is no longer revision, or until timeout
+// passes. Returns the revision then current. Thread-safe.
+uint64_t wait_for_scene_model_change(uint64_t revision, std::chrono::milliseconds timeout);
@@ -0,0 +1,165 @@
+// ShmEventRing.cpp
+#include "ShmEventRing.hpp"
+
+#include <obs-module.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+namespace {
+
+constexpr size_t kRecordsOffset =
+    (sizeof(ShmEventRingHeader) + kShmEventRecordSize - 1) / kShmEventRecordSize * kShmEventRecordSize;
+constexpr size_t kMappedSize = kRecordsOffset + kShmEventRingCapacity * kShmEventRecordSize;
+constexpr uint64_t kRecordMask = kShmEventRingCapacity - 1;
+static_assert((kShmEventRingCapacity & kRecordMask) == 0, "capacity must be a power of two");
+
+void* map_shared(int fd, size_t size) {
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return addr == MAP_FAILED ? nullptr : addr;
+}
+
+ShmEventRecord* records_of(ShmEventRingHeader* header) {
+    return reinterpret_cast<ShmEventRecord*>(reinterpret_cast<char*>(header) + kRecordsOffset);
+}
+
+} // namespace
+
+ShmEventReader::~ShmEventReader() {
+    destroy();
+}
+
+bool ShmEventReader::create(const std::string& name) {
+    destroy();
+
+    // A previous OBS instance may have left a ring behind; start clean.
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        blog(LOG_ERROR, "[hot-cue-mesh] shm_open(%s) failed: %s", name.c_str(), std::strerror(errno));
+        return false;
+    }
+
+    void* addr = nullptr;
+    if (ftruncate(fd, static_cast<off_t>(kMappedSize)) == 0) {
+        addr = map_shared(fd, kMappedSize);
+    }
+    ::close(fd);
+    if (!addr) {
+        blog(LOG_ERROR, "[hot-cue-mesh] mapping shm ring %s failed: %s", name.c_str(), std::strerror(errno));
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // Freshly truncated memory is zeroed; the header is published last so a
+    // writer never sees a half-initialised ring.
+    header_ = new (addr) ShmEventRingHeader();
+    header_->capacity = kShmEventRingCapacity;
+    header_->record_size = kShmEventRecordSize;
+    header_->version = kShmEventRingVersion;
+    header_->head.store(0, std::memory_order_relaxed);
+    header_->tail.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = kShmEventRingMagic;
+
+    records_ = records_of(header_);
+    mapped_size_ = kMappedSize;
+    name_ = name;
+
+    blog(LOG_INFO, "[hot-cue-mesh] listening for hot cue events on shm %s", name.c_str());
+    return true;
+}
+
+void ShmEventReader::destroy() {
+    if (!header_) return;
+
+    munmap(header_, mapped_size_);
+    shm_unlink(name_.c_str());
+    header_ = nullptr;
+    records_ = nullptr;
+    mapped_size_ = 0;
+    name_.clear();
+}
+
+size_t ShmEventReader::drain(size_t max, const std::function<void(std::string_view line)>& visit) {
+    if (!header_) return 0;
+
+    uint64_t head = header_->head.load(std::memory_order_relaxed);
+    const uint64_t tail = header_->tail.load(std::memory_order_acquire);
+
+    size_t count = 0;
+    while (head != tail && count < max) {
+        const ShmEventRecord& record = records_[head & kRecordMask];
+        const size_t length = record.length < sizeof(record.text) ? record.length : sizeof(record.text);
+        if (length > 0) {
+            visit(std::string_view(record.text, length));
+            ++count;
+        }
+        ++head;
+    }
+
+    header_->head.store(head, std::memory_order_release);
+    return count;
+}
+
+ShmEventWriter::~ShmEventWriter() {
+    close();
+}
+
+bool ShmEventWriter::open(const std::string& name) {
+    close();
+
+    const int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return false;
+
+    struct stat st{};
+    void* addr = nullptr;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= kMappedSize) {
+        addr = map_shared(fd, kMappedSize);
+    }
+    ::close(fd);
+    if (!addr) return false;
+
+    auto* header = static_cast<ShmEventRingHeader*>(addr);
+    if (header->magic != kShmEventRingMagic || header->version != kShmEventRingVersion ||
+        header->capacity != kShmEventRingCapacity || header->record_size != kShmEventRecordSize) {
+        munmap(addr, kMappedSize);
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    header_ = header;
+    records_ = records_of(header);
+    mapped_size_ = kMappedSize;
+    return true;
+}
+
+void ShmEventWriter::close() {
+    if (!header_) return;
+
+    munmap(header_, mapped_size_);
+    header_ = nullptr;
+    records_ = nullptr;
+    mapped_size_ = 0;
+}
+
+bool ShmEventWriter::write(std::string_view line) {
+    if (!header_ || line.empty() || line.size() > sizeof(ShmEventRecord::text)) return false;
+
+    const uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+    const uint64_t head = header_->head.load(std::memory_order_acquire);
+    if (tail - head >= kShmEventRingCapacity) return false;
+
+    ShmEventRecord& record = records_[tail & kRecordMask];
+    std::memcpy(record.text, line.data(), line.size());
+    record.length = static_cast<uint32_t>(line.size());
+
+    header_->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
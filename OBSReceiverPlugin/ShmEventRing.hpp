@@ -0,0 +1,85 @@
+// ShmEventRing.hpp
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Single-producer/single-consumer ring of fixed-size event records in a named
+// POSIX shared-memory object, for senders on the same machine. The OBS plugin
+// owns (creates and unlinks) the object and drains it from the tick callback;
+// one sender process attaches with ShmEventWriter. Each record carries one
+// event line, exactly what would otherwise be sent over TCP.
+//
+// The reader polls once per tick, so there is no doorbell: publishing a
+// record is two stores and never a syscall. Linux only.
+
+constexpr uint32_t kShmEventRingMagic = 0x48434d31; // "HCM1"
+constexpr uint32_t kShmEventRingVersion = 1;
+constexpr size_t kShmEventRecordSize = 256;
+constexpr size_t kShmEventRingCapacity = 1024; // records, power of two
+
+struct ShmEventRecord {
+    uint32_t length;
+    char text[kShmEventRecordSize - sizeof(uint32_t)];
+};
+static_assert(sizeof(ShmEventRecord) == kShmEventRecordSize, "record must stay fixed-size");
+
+struct ShmEventRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t record_size;
+    alignas(64) std::atomic<uint64_t> head; // next record to read, consumer-owned
+    alignas(64) std::atomic<uint64_t> tail; // next record to write, producer-owned
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "ring indices are shared across processes and must be lock-free");
+
+class ShmEventReader {
+public:
+    ShmEventReader() = default;
+    ~ShmEventReader();
+    ShmEventReader(const ShmEventReader&) = delete;
+    ShmEventReader& operator=(const ShmEventReader&) = delete;
+
+    // Creates (or recreates) the shared-memory object, e.g. "/hot-cue-mesh".
+    bool create(const std::string& name);
+    void destroy();
+
+    // Never blocks. Hands at most max lines to visit and returns the count.
+    // The view is only valid during the call.
+    size_t drain(size_t max, const std::function<void(std::string_view line)>& visit);
+
+private:
+    std::string name_;
+    ShmEventRingHeader* header_ = nullptr;
+    ShmEventRecord* records_ = nullptr;
+    size_t mapped_size_ = 0;
+};
+
+class ShmEventWriter {
+public:
+    ShmEventWriter() = default;
+    ~ShmEventWriter();
+    ShmEventWriter(const ShmEventWriter&) = delete;
+    ShmEventWriter& operator=(const ShmEventWriter&) = delete;
+
+    // Attaches to a ring created by the OBS plugin. Returns false if it does
+    // not exist (yet) or has an unexpected layout.
+    bool open(const std::string& name);
+    void close();
+    bool is_open() const { return header_ != nullptr; }
+
+    // Returns false if the ring is full or the line does not fit a record;
+    // callers fall back to the TCP path in that case.
+    bool write(std::string_view line);
+
+private:
+    ShmEventRingHeader* header_ = nullptr;
+    ShmEventRecord* records_ = nullptr;
+    size_t mapped_size_ = 0;
+};
@@ -0,0 +1,253 @@
+// SourceCache.cpp
+#include "SourceCache.hpp"
+
+#include <obs-frontend-api.h>
+
+#include <atomic>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+struct WeakSourceReleaser {
+    void operator()(obs_weak_source_t* weak) const noexcept { obs_weak_source_release(weak); }
+};
+
+using WeakSourcePtr = std::unique_ptr<obs_weak_source_t, WeakSourceReleaser>;
+
+constexpr uint64_t pair_key(NameId first, NameId second) noexcept {
+    return (static_cast<uint64_t>(first) << 32) | second;
+}
+
+// Bumped by invalidate_source_cache(); the tick drops the cache when it changes.
+std::atomic<uint64_t> g_generation{0};
+// Bumped by invalidate_scene_graph(): the low 32 bits of scene_graph_version().
+std::atomic<uint32_t> g_graph_generation{0};
+// The 21 bits above it, picked at random at start so versions from an earlier
+// load (almost) never match. Together they stay below 2^53, which JavaScript
+// clients can still hold exactly.
+constexpr unsigned kVersionEpochBits = 21;
+std::atomic<uint64_t> g_version_epoch{0};
+std::atomic<bool> g_started{false};
+
+std::atomic<uint64_t> g_hits{0};
+std::atomic<uint64_t> g_misses{0};
+std::atomic<uint64_t> g_invalidations{0};
+
+// Tick thread only.
+struct Cache {
+    uint64_t generation = 0;
+    // Indexed by NameId; grown on demand.
+    std::vector<WeakSourcePtr> scenes;
+    std::unordered_map<uint64_t, ObsSceneItemPtr> items;
+    // Scenes whose items (including nested groups) are all in items, so a
+    // miss there means the source really is not in that scene.
+    std::unordered_set<NameId> indexed_scenes;
+    std::unordered_map<uint64_t, WeakSourcePtr> filters;
+
+    void clear() {
+        scenes.clear();
+        items.clear();
+        indexed_scenes.clear();
+        filters.clear();
+    }
+};
+
+Cache g_cache;
+
+void invalidate() {
+    g_generation.fetch_add(1, std::memory_order_release);
+}
+
+void sync() {
+    const uint64_t generation = g_generation.load(std::memory_order_acquire);
+    if (generation == g_cache.generation) return;
+
+    g_cache.clear();
+    g_cache.generation = generation;
+    g_invalidations.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline const char* safe_source_name(const obs_source_t* source) {
+    const char* name = source ? obs_source_get_name(source) : nullptr;
+    return name ? name : "";
+}
+
+struct IndexData {
+    NameId scene;
+    std::vector<ObsSourcePtr>* groups;
+};
+
+bool index_scene_item(obs_scene_t*, obs_sceneitem_t* item, void* param) {
+    auto* data = static_cast<IndexData*>(param);
+    obs_source_t* source = obs_sceneitem_get_source(item);
+    NameId name;
+    if (!source || !intern_name(safe_source_name(source), name)) {
+        return true;
+    }
+
+    const auto [it, inserted] = g_cache.items.try_emplace(pair_key(data->scene, name));
+    if (inserted) {
+        obs_sceneitem_addref(item);
+        it->second.reset(item);
+    }
+    if (obs_sceneitem_is_group(item)) {
+        data->groups->emplace_back(obs_source_get_ref(source));
+    }
+    return true;
+}
+
+// Level by level, so items closer to the top of the scene win.
+void index_scene(NameId scene, obs_source_t* scene_source) {
+    g_cache.indexed_scenes.insert(scene);
+
+    std::vector<ObsSourcePtr> groups;
+    IndexData data{scene, &groups};
+    obs_scene_enum_items(obs_scene_from_source(scene_source), index_scene_item, &data);
+    for (size_t i = 0; i < groups.size(); ++i) {
+        if (obs_scene_t* group = obs_group_from_source(groups[i].get())) {
+            obs_scene_enum_items(group, index_scene_item, &data);
+        }
+    }
+}
+
+ObsSourcePtr lookup_weak(std::unordered_map<uint64_t, WeakSourcePtr>& map, uint64_t key) {
+    const auto it = map.find(key);
+    if (it == map.end()) return nullptr;
+
+    ObsSourcePtr source(obs_weak_source_get_source(it->second.get()));
+    if (!source) {
+        map.erase(it);
+    }
+    return source;
+}
+
+bool scene_cached(NameId scene) {
+    return scene < g_cache.scenes.size() && g_cache.scenes[scene];
+}
+
+ObsSourcePtr find_scene(NameId scene) {
+    if (scene_cached(scene)) {
+        ObsSourcePtr source(obs_weak_source_get_source(g_cache.scenes[scene].get()));
+        if (source) return source;
+        g_cache.scenes[scene].reset();
+    }
+
+    // name_view() is NUL-terminated.
+    ObsSourcePtr source(obs_get_source_by_name(name_view(scene).data()));
+    if (!source || !obs_scene_from_source(source.get())) return nullptr;
+
+    if (scene >= g_cache.scenes.size()) g_cache.scenes.resize(scene + 1);
+    g_cache.scenes[scene].reset(obs_source_get_weak_source(source.get()));
+    return source;
+}
+
+} // namespace
+
+void start_source_cache() {
+    if (g_started.exchange(true)) return;
+
+    const uint64_t epoch = std::random_device{}() & ((1u << kVersionEpochBits) - 1);
+    g_version_epoch.store(epoch << 32, std::memory_order_relaxed);
+    invalidate();
+}
+
+void stop_source_cache() {
+    if (!g_started.exchange(false)) return;
+
+    g_cache.clear();
+}
+
+ObsSourcePtr resolve_scene(NameId scene) {
+    sync();
+    const bool cached = scene_cached(scene);
+    ObsSourcePtr source = find_scene(scene);
+    if (cached && source) {
+        g_hits.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        g_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+    return source;
+}
+
+ObsSceneItemPtr resolve_scene_item(NameId scene, NameId source) {
+    sync();
+
+    ObsSourcePtr scene_source;
+    if (scene == kNoName) {
+        scene_source.reset(obs_frontend_get_current_scene());
+        if (!scene_source || !intern_name(safe_source_name(scene_source.get()), scene)) return nullptr;
+    }
+
+    const uint64_t key = pair_key(scene, source);
+    auto it = g_cache.items.find(key);
+    if (it == g_cache.items.end()) {
+        g_misses.fetch_add(1, std::memory_order_relaxed);
+        if (g_cache.indexed_scenes.count(scene) != 0) return nullptr;
+
+        if (!scene_source) {
+            scene_source = find_scene(scene);
+            if (!scene_source) return nullptr;
+        }
+        index_scene(scene, scene_source.get());
+        it = g_cache.items.find(key);
+        if (it == g_cache.items.end()) return nullptr;
+    } else {
+        g_hits.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    obs_sceneitem_t* item = it->second.get();
+    // Removed from its scene since we indexed it.
+    if (!obs_sceneitem_get_scene(item)) {
+        g_cache.items.erase(it);
+        return nullptr;
+    }
+    obs_sceneitem_addref(item);
+    return ObsSceneItemPtr(item);
+}
+
+ObsSourcePtr resolve_filter(NameId source, NameId filter) {
+    sync();
+
+    const uint64_t key = pair_key(source, filter);
+    if (ObsSourcePtr cached = lookup_weak(g_cache.filters, key)) {
+        g_hits.fetch_add(1, std::memory_order_relaxed);
+        return cached;
+    }
+    g_misses.fetch_add(1, std::memory_order_relaxed);
+
+    ObsSourcePtr parent(obs_get_source_by_name(name_view(source).data()));
+    if (!parent) return nullptr;
+    ObsSourcePtr found(obs_source_get_filter_by_name(parent.get(), name_view(filter).data()));
+    if (!found) return nullptr;
+
+    g_cache.filters.emplace(key, WeakSourcePtr(obs_source_get_weak_source(found.get())));
+    return found;
+}
+
+void sync_source_cache() {
+    sync();
+}
+
+void invalidate_source_cache() {
+    invalidate();
+}
+
+void invalidate_scene_graph() {
+    g_graph_generation.fetch_add(1, std::memory_order_release);
+    invalidate();
+}
+
+uint64_t scene_graph_version() {
+    return g_version_epoch.load(std::memory_order_relaxed) | g_graph_generation.load(std::memory_order_acquire);
+}
+
+SourceCacheStats source_cache_stats() {
+    SourceCacheStats s;
+    s.hits = g_hits.load(std::memory_order_relaxed);
+    s.misses = g_misses.load(std::memory_order_relaxed);
+    s.invalidations = g_invalidations.load(std::memory_order_relaxed);
+    return s;
+}
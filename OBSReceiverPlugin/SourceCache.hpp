@@ -0,0 +1,72 @@
+// SourceCache.hpp
+#pragma once
+
+#include <obs-module.h>
+
+#include <cstdint>
+#include <memory>
+
+#include "NameTable.hpp"
+
+struct ObsSourceReleaser {
+    void operator()(obs_source_t* source) const noexcept { obs_source_release(source); }
+};
+
+struct ObsSceneItemReleaser {
+    void operator()(obs_sceneitem_t* item) const noexcept { obs_sceneitem_release(item); }
+};
+
+using ObsSourcePtr = std::unique_ptr<obs_source_t, ObsSourceReleaser>;
+using ObsSceneItemPtr = std::unique_ptr<obs_sceneitem_t, ObsSceneItemReleaser>;
+
+// Maps interned scene/source/filter names to the OBS objects they name, so
+// executing a command is a hash lookup instead of a walk over the scene graph.
+// Scenes and filters are held as weak references, scene items (which have no
+// weak form) with an item reference. Sources inside groups are found through
+// the scene that contains the group; a top-level item wins over a nested one
+// with the same name.
+//
+// The scene model (SceneModel.hpp) drops the whole cache on every change that
+// may alter what a name resolves to; it is refilled lazily, one scene at a
+// time. An item reference keeps its source alive, so the tick lets go of the
+// dropped cache right away through sync_source_cache(), not at the next
+// lookup, which may never come. The resolve_* functions are for the tick
+// thread only (the graphics thread, which also runs OBS_TASK_GRAPHICS tasks).
+void start_source_cache();
+void stop_source_cache();
+
+// Drops the cache at the tick's next lookup, e.g. when filters or inputs
+// come and go. Thread-safe.
+void invalidate_source_cache();
+
+// Same, for a change to the scene graph itself (scenes or scene items added,
+// removed or renamed); also moves scene_graph_version(). Thread-safe.
+void invalidate_scene_graph();
+
+// Releases everything the cache holds if it was invalidated since the last
+// call or lookup. Cheap otherwise; call on every tick. Tick thread only.
+void sync_source_cache();
+
+// A scene (not a group) by name.
+ObsSourcePtr resolve_scene(NameId scene);
+
+// The item named source in scene, or in the current scene if scene is
+// kNoName. Looks into nested groups.
+ObsSceneItemPtr resolve_scene_item(NameId scene, NameId source);
+
+// The filter named filter on the source (or scene) named source.
+ObsSourcePtr resolve_filter(NameId source, NameId filter);
+
+// Changes with every invalidate_scene_graph(), and differs between plugin
+// loads. Handed out by /obsState so senders using #id references can be told
+// cheaply that theirs are stale. Always below 2^53, so it survives a round
+// trip through a JavaScript number. Thread-safe.
+uint64_t scene_graph_version();
+
+struct SourceCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t invalidations = 0;
+};
+
+SourceCacheStats source_cache_stats();
@@ -1,12 +1,22 @@
 #include "StateReader.hpp"
+#include "ObsStateJson.hpp"
+#include "SceneModel.hpp"
 
 #include <obs-module.h>
 
 #include <atomic>
 #include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
 
 #include <httplib.h>
 #include <nlohmann/json.hpp>
@@ -17,141 +27,215 @@ std::unique_ptr<httplib::Server> g_srv;
 std::unique_ptr<std::thread> g_thr;
 std::atomic<bool> g_running{false};
 
-struct SourceFlagName {
-    uint32_t flag;
-    const char *name;
+// ?format= on /obsState. Nested is the original layout, where every item
+// repeats its source, filters and flag names. Normalized lists each source
+// once and has items refer to it by id:
+//
+//   {"format":"normalized",
+//    "scenes":[{"id":1,"items":[{"source":2,"visible":true}],"name":"Main"}],
+//    "sourceFlags":{"OBS_SOURCE_VIDEO":1,...},
+//    "sources":[{"filters":[{"enabled":true,"id":3,"name":"Blur"}],"flags":1,
+//                "id":2,"name":"Cam"}],
+//    "version":...}
+//
+// "flags" is the OBS output flags bitmask, cut down to the flags named in
+// "sourceFlags". Sources are listed in the order they first appear.
+enum class ObsStateFormat : uint8_t {
+    Nested,
+    Normalized,
 };
 
-constexpr std::array<SourceFlagName, 17> kSourceFlagNames{{
-    {OBS_SOURCE_VIDEO, "OBS_SOURCE_VIDEO"},
-    {OBS_SOURCE_AUDIO, "OBS_SOURCE_AUDIO"},
-    {OBS_SOURCE_ASYNC, "OBS_SOURCE_ASYNC"},
-    {OBS_SOURCE_CUSTOM_DRAW, "OBS_SOURCE_CUSTOM_DRAW"},
-    {OBS_SOURCE_INTERACTION, "OBS_SOURCE_INTERACTION"},
-    {OBS_SOURCE_COMPOSITE, "OBS_SOURCE_COMPOSITE"},
-    {OBS_SOURCE_DO_NOT_DUPLICATE, "OBS_SOURCE_DO_NOT_DUPLICATE"},
-    {OBS_SOURCE_DEPRECATED, "OBS_SOURCE_DEPRECATED"},
-    {OBS_SOURCE_DO_NOT_SELF_MONITOR, "OBS_SOURCE_DO_NOT_SELF_MONITOR"},
-    {OBS_SOURCE_CAP_DISABLED, "OBS_SOURCE_CAP_DISABLED"},
-    {OBS_SOURCE_MONITOR_BY_DEFAULT, "OBS_SOURCE_MONITOR_BY_DEFAULT"},
-    {OBS_SOURCE_SUBMIX, "OBS_SOURCE_SUBMIX"},
-    {OBS_SOURCE_CONTROLLABLE_MEDIA, "OBS_SOURCE_CONTROLLABLE_MEDIA"},
-    {OBS_SOURCE_CEA_708, "OBS_SOURCE_CEA_708"},
-    {OBS_SOURCE_SRGB, "OBS_SOURCE_SRGB"},
-    {OBS_SOURCE_CAP_DONT_SHOW_PROPERTIES, "OBS_SOURCE_CAP_DONT_SHOW_PROPERTIES"},
-    {OBS_SOURCE_REQUIRES_CANVAS, "OBS_SOURCE_REQUIRES_CANVAS"},
-}};
-
-inline const char *safe_source_name(const obs_source_t *source) {
-    const char *name = source ? obs_source_get_name(source) : nullptr;
-    return name ? name : "";
-}
-
-nlohmann::json::array_t build_source_flags(uint32_t flags) {
-    nlohmann::json::array_t source_flags;
-    source_flags.reserve(kSourceFlagNames.size());
-
-    for (const auto &entry : kSourceFlagNames) {
-        if (flags & entry.flag) {
-            source_flags.emplace_back(entry.name);
-        }
-    }
+constexpr size_t kObsStateFormatCount = 2;
 
-    return source_flags;
-}
-
-struct FilterEnumData {
-    nlohmann::json::array_t *filters;
+// A serialized /obsState body. Built at most once per scene model revision
+// and format, however many clients poll.
+struct CachedBody {
+    uint64_t revision = 0;
+    std::shared_ptr<const SceneGraphSnapshot> snapshot;
+    std::string etag;
+    std::string body;
 };
 
-void enum_source_filter(obs_source_t *, obs_source_t *filter, void *param) {
-    auto *data = static_cast<FilterEnumData *>(param);
-    if (!data || !data->filters || !filter) {
-        return;
-    }
-
-    nlohmann::json filter_json;
-    filter_json["name"] = safe_source_name(filter);
-    filter_json["enabled"] = obs_source_enabled(filter);
-    data->filters->emplace_back(std::move(filter_json));
+// Indexed by ObsStateFormat. Only through std::atomic_load/std::atomic_store.
+std::array<std::shared_ptr<const CachedBody>, kObsStateFormatCount> g_bodies;
+// Held while building, so requests that find the body stale at the same time
+// share one build instead of each doing their own.
+std::mutex g_build_mu;
+
+std::atomic<uint64_t> g_requests{0};
+std::atomic<uint64_t> g_not_modified{0};
+std::atomic<uint64_t> g_builds{0};
+
+// /obsState/stream. Each stream holds one of the server's worker threads for
+// as long as it is open, so they are capped below the pool size.
+constexpr int kMaxStreams = 4;
+constexpr size_t kStreamHistory = 64;
+constexpr auto kStreamKeepAlive = std::chrono::seconds(15);
+// How long a stream waits for a change before checking for shutdown.
+constexpr auto kStreamPoll = std::chrono::milliseconds(500);
+
+std::atomic<int> g_streams{0};
+std::atomic<bool> g_streams_stopping{false};
+std::atomic<uint64_t> g_streams_opened{0};
+
+// Recent snapshots clients were sent (as a stream event or an /obsState
+// body), oldest first, so one resuming from any of them gets a patch.
+std::mutex g_history_mu;
+std::deque<std::shared_ptr<const SceneGraphSnapshot>> g_history;
+
+// The per-load epoch in graph_version keeps tags from an earlier load from
+// matching a revision that happens to be reused.
+std::string make_etag(const SceneGraphSnapshot &snapshot, ObsStateFormat format) {
+    char etag[48];
+    std::snprintf(etag, sizeof(etag), "\"%016" PRIx64 "-%" PRIx64 "%s\"", snapshot.graph_version,
+                  snapshot.revision, format == ObsStateFormat::Normalized ? "-n" : "");
+    return etag;
 }
 
-nlohmann::json::array_t build_source_filters(obs_source_t *source) {
-    nlohmann::json::array_t filters;
-    if (!source) {
-        return filters;
+void remember_sent(const std::shared_ptr<const SceneGraphSnapshot> &snapshot) {
+    std::lock_guard<std::mutex> lk(g_history_mu);
+    for (const auto &sent : g_history) {
+        if (sent->revision == snapshot->revision) return;
     }
-
-    FilterEnumData data{&filters};
-    obs_source_enum_filters(source, enum_source_filter, &data);
-    return filters;
+    g_history.push_back(snapshot);
+    if (g_history.size() > kStreamHistory) g_history.pop_front();
 }
 
-struct SceneItemEnumData {
-    nlohmann::json::array_t *sources;
-};
-
-bool enum_scene_item(obs_scene_t *, obs_sceneitem_t *item, void *param) {
-    auto *data = static_cast<SceneItemEnumData *>(param);
-    if (!data || !data->sources || !item) {
-        return true;
+std::shared_ptr<const SceneGraphSnapshot> find_sent(uint64_t revision) {
+    std::lock_guard<std::mutex> lk(g_history_mu);
+    for (const auto &sent : g_history) {
+        if (sent->revision == revision) return sent;
     }
+    return nullptr;
+}
 
-    obs_source_t *source = obs_sceneitem_get_source(item);
-    if (!source) {
-        return true;
+std::shared_ptr<const CachedBody> obs_state_body(ObsStateFormat format = ObsStateFormat::Nested) {
+    std::shared_ptr<const CachedBody> &cached = g_bodies[static_cast<size_t>(format)];
+    std::shared_ptr<const SceneGraphSnapshot> snapshot = scene_graph_snapshot();
+    std::shared_ptr<const CachedBody> body = std::atomic_load(&cached);
+    if (body && body->revision == snapshot->revision) return body;
+
+    std::lock_guard<std::mutex> lk(g_build_mu);
+    // Whoever held the lock may have built it already, or the model may have
+    // moved on since.
+    snapshot = scene_graph_snapshot();
+    body = std::atomic_load(&cached);
+    if (body && body->revision == snapshot->revision) return body;
+
+    auto next = std::make_shared<CachedBody>();
+    next->revision = snapshot->revision;
+    next->snapshot = snapshot;
+    next->etag = make_etag(*snapshot, format);
+    // Sized from the last body, which is usually within a few bytes.
+    next->body.reserve(body ? body->body.size() + body->body.size() / 8 : 4096);
+    if (format == ObsStateFormat::Normalized) {
+        write_normalized_obs_state(*snapshot, next->body);
+    } else {
+        write_obs_state(*snapshot, next->body);
     }
+    g_builds.fetch_add(1, std::memory_order_relaxed);
 
-    nlohmann::json source_json;
-    source_json["name"] = safe_source_name(source);
-    source_json["sourceFlags"] = build_source_flags(obs_source_get_output_flags(source));
-    source_json["filters"] = build_source_filters(source);
-    source_json["visible"] = obs_sceneitem_visible(item);
-
-    data->sources->emplace_back(std::move(source_json));
-    return true;
+    body = std::move(next);
+    std::atomic_store(&cached, body);
+    // Stream patches are against the nested layout.
+    if (format == ObsStateFormat::Nested) remember_sent(body->snapshot);
+    return body;
 }
 
-struct SceneEnumData {
-    nlohmann::json::array_t *scenes;
+struct ObsStateStream {
+    // What the client has; null until the first snapshot.
+    std::shared_ptr<const SceneGraphSnapshot> sent;
+    std::chrono::steady_clock::time_point last_write;
 };
 
-bool enum_scene(void *param, obs_source_t *scene_source) {
-    auto *data = static_cast<SceneEnumData *>(param);
-    if (!data || !data->scenes || !scene_source) {
-        return true;
-    }
+// One server-sent event; the id is the revision a client resumes from.
+bool write_event(httplib::DataSink &sink, const char *event, uint64_t id, const std::string &data) {
+    std::string message;
+    message.reserve(data.size() + 64);
+    message += "id: ";
+    message += std::to_string(id);
+    message += "\nevent: ";
+    message += event;
+    message += "\ndata: ";
+    message += data; // dump() output is a single line
+    message += "\n\n";
+    return sink.write(message.data(), message.size());
+}
 
-    // Groups are scene-like internals; top-level response should contain scenes.
-    if (obs_source_is_group(scene_source)) {
-        return true;
+// Called by httplib for as long as it returns true: writes the next event,
+// waiting for the model to change first if the client is up to date.
+bool pump_stream(ObsStateStream &stream, httplib::DataSink &sink) {
+    if (!stream.sent) {
+        std::shared_ptr<const CachedBody> body = obs_state_body();
+        stream.sent = body->snapshot;
+        stream.last_write = std::chrono::steady_clock::now();
+        return write_event(sink, "snapshot", body->revision, body->body);
     }
 
-    obs_scene_t *scene = obs_scene_from_source(scene_source);
-    if (!scene) {
-        return true;
+    while (!g_streams_stopping.load(std::memory_order_acquire)) {
+        const auto now = std::chrono::steady_clock::now();
+        std::shared_ptr<const SceneGraphSnapshot> snapshot = scene_graph_snapshot();
+        if (snapshot->revision != stream.sent->revision) {
+            nlohmann::json::array_t ops = diff_obs_state(*stream.sent, *snapshot);
+            stream.sent = std::move(snapshot);
+            // Revisions that change nothing listed (group contents, say)
+            // are skipped.
+            if (ops.empty()) continue;
+
+            remember_sent(stream.sent);
+            stream.last_write = now;
+            return write_event(sink, "patch", stream.sent->revision, nlohmann::json(std::move(ops)).dump());
+        }
+        if (now - stream.last_write >= kStreamKeepAlive) {
+            static constexpr char kKeepAlive[] = ": keep-alive\n\n";
+            stream.last_write = now;
+            return sink.write(kKeepAlive, sizeof(kKeepAlive) - 1);
+        }
+        wait_for_scene_model_change(stream.sent->revision, kStreamPoll);
     }
+    return false;
+}
 
-    nlohmann::json scene_json;
-    scene_json["name"] = safe_source_name(scene_source);
-
-    nlohmann::json::array_t sources;
-    SceneItemEnumData scene_item_data{&sources};
-    obs_scene_enum_items(scene, enum_scene_item, &scene_item_data);
-    scene_json["sources"] = std::move(sources);
+// since=<revision>, or Last-Event-ID when an EventSource reconnects.
+uint64_t requested_since(const httplib::Request &req) {
+    std::string since;
+    if (req.has_param("since")) {
+        since = req.get_param_value("since");
+    } else if (req.has_header("Last-Event-ID")) {
+        since = req.get_header_value("Last-Event-ID");
+    }
+    return since.empty() ? 0 : std::strtoull(since.c_str(), nullptr, 10);
+}
 
-    data->scenes->emplace_back(std::move(scene_json));
+bool requested_format(const httplib::Request &req, ObsStateFormat &format) {
+    const std::string name = req.has_param("format") ? req.get_param_value("format") : "nested";
+    if (name == "nested") {
+        format = ObsStateFormat::Nested;
+    } else if (name == "normalized") {
+        format = ObsStateFormat::Normalized;
+    } else {
+        return false;
+    }
     return true;
 }
 
-nlohmann::json build_obs_state_json() {
-    nlohmann::json::array_t scenes;
-    SceneEnumData data{&scenes};
-    obs_enum_scenes(enum_scene, &data);
-
-    nlohmann::json result;
-    result["scenes"] = std::move(scenes);
-    return result;
+// If-None-Match is "*" or a comma-separated list of entity tags, which may be
+// weak (W/"...").
+bool etag_matches(const std::string &header, const std::string &etag) {
+    size_t pos = 0;
+    while (pos < header.size()) {
+        size_t end = header.find(',', pos);
+        if (end == std::string::npos) end = header.size();
+
+        std::string_view tag(header.data() + pos, end - pos);
+        while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t')) tag.remove_prefix(1);
+        while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t')) tag.remove_suffix(1);
+        if (tag.substr(0, 2) == "W/") tag.remove_prefix(2);
+        if (tag == "*" || tag == etag) return true;
+
+        pos = end + 1;
+    }
+    return false;
 }
 } // namespace
 
@@ -161,9 +245,57 @@ void start_state_reader_server(int port) {
 
     g_srv = std::make_unique<httplib::Server>();
 
-    g_srv->Get("/obsState", [](const httplib::Request&, httplib::Response& res) {
-        nlohmann::json j = build_obs_state_json();
-        res.set_content(j.dump(), "application/json");
+    g_srv->Get("/obsState", [](const httplib::Request& req, httplib::Response& res) {
+        g_requests.fetch_add(1, std::memory_order_relaxed);
+        ObsStateFormat format;
+        if (!requested_format(req, format)) {
+            res.set_content("unknown format; use nested or normalized", "text/plain");
+            res.status = 400;
+            return;
+        }
+
+        std::shared_ptr<const CachedBody> body = obs_state_body(format);
+        res.set_header("ETag", body->etag);
+        res.set_header("Cache-Control", "no-cache");
+        // What /obsState/stream takes as since= to pick up from this body.
+        res.set_header("X-Obs-State-Revision", std::to_string(body->revision));
+        if (etag_matches(req.get_header_value("If-None-Match"), body->etag)) {
+            g_not_modified.fetch_add(1, std::memory_order_relaxed);
+            res.status = 304;
+            return;
+        }
+
+        // Written straight from the cached body, which the provider keeps alive.
+        res.set_content_provider(body->body.size(), "application/json",
+                                 [body](size_t offset, size_t length, httplib::DataSink& sink) {
+                                     return sink.write(body->body.data() + offset, length);
+                                 });
+        res.status = 200;
+    });
+
+    // Server-sent events: a "snapshot" event with the /obsState body, then a
+    // "patch" event (a JSON Patch against that document) for every change.
+    // Event ids are revisions; a client that reconnects with one it has seen
+    // recently gets a patch instead of a new snapshot.
+    g_srv->Get("/obsState/stream", [](const httplib::Request& req, httplib::Response& res) {
+        if (g_streams.fetch_add(1, std::memory_order_relaxed) >= kMaxStreams) {
+            g_streams.fetch_sub(1, std::memory_order_relaxed);
+            res.set_content("too many streams", "text/plain");
+            res.status = 503;
+            return;
+        }
+        g_streams_opened.fetch_add(1, std::memory_order_relaxed);
+
+        auto stream = std::make_shared<ObsStateStream>();
+        if (req.has_param("since") || req.has_header("Last-Event-ID")) {
+            stream->sent = find_sent(requested_since(req));
+            stream->last_write = std::chrono::steady_clock::now();
+        }
+        res.set_header("Cache-Control", "no-cache");
+        res.set_chunked_content_provider(
+            "text/event-stream",
+            [stream](size_t, httplib::DataSink& sink) { return pump_stream(*stream, sink); },
+            [](bool) { g_streams.fetch_sub(1, std::memory_order_relaxed); });
         res.status = 200;
     });
 
@@ -173,6 +305,7 @@ void start_state_reader_server(int port) {
         res.status = 200;
     });
 
+    g_streams_stopping.store(false, std::memory_order_release);
     g_running.store(true);
     g_thr = std::make_unique<std::thread>([port]() {
         // listen() blocks until stop() is called
@@ -205,6 +338,18 @@ void stop_state_reader_server() {
         g_running.store(false);
     }
 
+    // Open streams notice within kStreamPoll and return their worker threads.
+    g_streams_stopping.store(true, std::memory_order_release);
     if (srv) srv->stop();
     if (thr && thr->joinable()) thr->join();
+
+    const uint64_t requests = g_requests.load(std::memory_order_relaxed);
+    const uint64_t streams = g_streams_opened.load(std::memory_order_relaxed);
+    if (requests > 0 || streams > 0) {
+        blog(LOG_INFO, "[hot-cue-mesh] /obsState: %llu requests, %llu not modified, %llu builds, %llu streams",
+             static_cast<unsigned long long>(requests),
+             static_cast<unsigned long long>(g_not_modified.load(std::memory_order_relaxed)),
+             static_cast<unsigned long long>(g_builds.load(std::memory_order_relaxed)),
+             static_cast<unsigned long long>(streams));
+    }
 }
@@ -0,0 +1,131 @@
+// TimerWheel.hpp
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Hierarchical timing wheel for values due at a point on a nanosecond clock.
+//
+// Time advances in ticks of resolution_ns. Level 0 has one slot per tick,
+// every further level one slot per full turn of the level below; with four
+// levels of 64 slots and 1 ms ticks that covers about 4.6 hours. Scheduling
+// is O(1), and advancing touches one level-0 slot per tick plus an occasional
+// cascade that re-files a higher slot into the levels below. Values due
+// further out than the wheel reaches are parked in the last slot and re-filed
+// until they come within range. Values scheduled back to back for the same
+// tick stay adjacent and in order, also across cascades.
+//
+// Not thread-safe.
+template <typename T>
+class TimerWheel {
+public:
+    static constexpr size_t kLevels = 4;
+    static constexpr size_t kSlotBits = 6;
+    static constexpr size_t kSlots = size_t{1} << kSlotBits;
+    // Ticks ahead of now the wheel reaches without parking values in its
+    // last slot: 2^24, about 4.6 hours at 1 ms ticks.
+    static constexpr uint64_t kSpanTicks = uint64_t{1} << (kLevels * kSlotBits);
+
+    explicit TimerWheel(uint64_t resolution_ns = 1'000'000) : resolution_ns_(resolution_ns) {}
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Returns false, leaving value untouched, if due_ns is not after the time
+    // the wheel has advanced to; the caller should act on it right away.
+    bool schedule(uint64_t due_ns, T& value) {
+        const uint64_t tick = due_ns / resolution_ns_;
+        if (tick <= now_tick_) return false;
+        file(Entry{tick, std::move(value)});
+        ++size_;
+        return true;
+    }
+
+    // Moves the wheel to now_ns and hands every value due by then to fire, in
+    // due order. Going backwards is a no-op.
+    template <typename Fire>
+    void advance(uint64_t now_ns, Fire&& fire) {
+        const uint64_t target = now_ns / resolution_ns_;
+        if (size_ == 0) {
+            // Nothing to fire on the way; skip the walk.
+            if (target > now_tick_) now_tick_ = target;
+            return;
+        }
+
+        while (now_tick_ < target && size_ > 0) {
+            ++now_tick_;
+            cascade();
+
+            std::vector<Entry>& slot = slots_[0][now_tick_ & (kSlots - 1)];
+            if (slot.empty()) continue;
+
+            fired_.swap(slot);
+            // Level 0 only ever holds entries due on the tick of their slot.
+            for (Entry& entry : fired_) {
+                --size_;
+                fire(entry.value);
+            }
+            fired_.clear();
+        }
+        if (now_tick_ < target) now_tick_ = target;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    void clear() {
+        for (auto& level : slots_) {
+            for (std::vector<Entry>& slot : level) slot.clear();
+        }
+        size_ = 0;
+    }
+
+private:
+    struct Entry {
+        uint64_t tick;
+        T value;
+    };
+
+    // Puts entry into the lowest level whose span still reaches its tick.
+    void file(Entry&& entry) {
+        const uint64_t delta = entry.tick - now_tick_;
+        size_t level = 0;
+        while (level + 1 < kLevels && delta >= (uint64_t{1} << (kSlotBits * (level + 1)))) ++level;
+
+        uint64_t tick = entry.tick;
+        if (delta >= (uint64_t{1} << (kSlotBits * kLevels))) {
+            // Out of range: the slot just before now in the top level comes
+            // around last.
+            tick = now_tick_ + (uint64_t{1} << (kSlotBits * kLevels)) - 1;
+        }
+        const size_t slot = static_cast<size_t>(tick >> (kSlotBits * level)) & (kSlots - 1);
+        slots_[level][slot].push_back(std::move(entry));
+    }
+
+    // Called once now_tick_ has moved to a new tick: every level whose lower
+    // neighbour just wrapped re-files its current slot downwards.
+    void cascade() {
+        for (size_t level = 1; level < kLevels; ++level) {
+            const uint64_t mask = (uint64_t{1} << (kSlotBits * level)) - 1;
+            if ((now_tick_ & mask) != 0) break;
+
+            const size_t slot = static_cast<size_t>(now_tick_ >> (kSlotBits * level)) & (kSlots - 1);
+            cascading_.swap(slots_[level][slot]);
+            for (Entry& entry : cascading_) {
+                if (entry.tick < now_tick_) entry.tick = now_tick_;
+                file(std::move(entry));
+            }
+            cascading_.clear();
+        }
+    }
+
+    const uint64_t resolution_ns_;
+    uint64_t now_tick_ = 0;
+    size_t size_ = 0;
+    std::array<std::array<std::vector<Entry>, kSlots>, kLevels> slots_;
+    std::vector<Entry> fired_;
+    std::vector<Entry> cascading_;
+};
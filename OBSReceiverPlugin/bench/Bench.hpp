@@ -0,0 +1,37 @@
+// Bench.hpp
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Minimal timing for the benchmark executables: every case runs a few times
+// and the fastest run is reported, per operation. Numbers are only comparable
+// within one run on one machine.
+
+// Every case folds a checksum of its results in here, so the work that made
+// them cannot be optimized away.
+inline volatile uint64_t g_sink = 0;
+
+// body() does ops operations and returns a checksum. Prints and returns the
+// fastest run's nanoseconds per operation.
+template <typename Body>
+double bench(const char* name, size_t ops, Body&& body, int repetitions = 5) {
+    double best = 0;
+    for (int i = 0; i < repetitions; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t checksum = body();
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        g_sink = g_sink + checksum;
+        const double per_op = elapsed.count() / static_cast<double>(ops);
+        best = i == 0 ? per_op : std::min(best, per_op);
+    }
+    if (best >= 1e6) {
+        std::printf("%-48s %12.2f ms/op\n", name, best / 1e6);
+    } else {
+        std::printf("%-48s %12.1f ns/op\n", name, best);
+    }
+    return best;
+}
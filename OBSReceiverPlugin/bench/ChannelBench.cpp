@@ -0,0 +1,102 @@
+// ChannelBench.cpp
+//
+// EventChannel against the mutex-guarded deque it replaced (user-002): some
+// producers push commands as fast as they can, one consumer drains them with
+// try_pop() as the tick does, and the time per command is reported.
+#include "Bench.hpp"
+#include "Channel.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t kCommands = 2'000'000;
+
+// The channel before the ring: a deque under a mutex, with a condition
+// variable for a consumer parked in pop().
+class MutexChannel {
+public:
+    bool push(EventCommand command) {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            queue_.push_back(command);
+        }
+        cv_.notify_one();
+        return true;
+    }
+
+    bool try_pop(EventCommand& out) {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (queue_.empty()) return false;
+        out = queue_.front();
+        queue_.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<EventCommand> queue_;
+};
+
+template <typename Channel>
+uint64_t run(Channel& channel, size_t producers) {
+    std::vector<std::thread> threads;
+    std::atomic<bool> go{false};
+    const size_t per_producer = kCommands / producers;
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            EventCommand command;
+            command.type = EventType::ShowSource;
+            command.flags = kCommandEndsLine;
+            command.origin = static_cast<uint16_t>(p + 1);
+            for (size_t i = 0; i < per_producer; ++i) {
+                command.received_ns = i;
+                while (!channel.push(command)) std::this_thread::yield();
+            }
+        });
+    }
+
+    go.store(true, std::memory_order_release);
+    uint64_t checksum = 0;
+    EventCommand command;
+    for (size_t popped = 0; popped < per_producer * producers;) {
+        if (channel.try_pop(command)) {
+            checksum += command.received_ns;
+            ++popped;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    for (std::thread& thread : threads) thread.join();
+    return checksum;
+}
+
+} // namespace
+
+int main() {
+    // Contention needs cores: with fewer than producers + 1, this mostly
+    // measures the scheduler.
+    std::printf("%zu commands per run, one consumer, %u hardware threads\n", kCommands,
+                std::thread::hardware_concurrency());
+    for (const size_t producers : {1, 2, 4}) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "mutex deque, %zu producers", producers);
+        bench(name, kCommands, [&] {
+            MutexChannel channel;
+            return run(channel, producers);
+        });
+        std::snprintf(name, sizeof(name), "EventChannel (Block), %zu producers", producers);
+        bench(name, kCommands, [&] {
+            EventChannel channel({kMaxChannelCapacity, OverflowPolicy::Block});
+            return run(channel, producers);
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+// ListenerBench.cpp
+//
+// The Linux listener end to end, per backend (epoll, io_uring: user-009) and
+// per transport (loopback TCP, AF_UNIX: user-006): one sender's latency from
+// write() to the sink, one line at a time, and its throughput writing lines in
+// bulk. Each run ends with the listener's own log of the syscalls it made, for
+// syscalls per line. Without liburing the io_uring runs fall back to epoll, and
+// say so in the log.
+#include "Bench.hpp"
+#include "Listener.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace {
+
+constexpr size_t kRoundTrips = 20'000;
+constexpr size_t kBulkLines = 512 * 1024; // whole writes of 1024 lines
+constexpr std::string_view kLine = "show_source -scene_name Scene -source_name Camera\n";
+
+std::atomic<uint64_t> g_received{0};
+
+int connect_tcp(unsigned short port) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::perror("connect");
+        std::exit(1);
+    }
+    return fd;
+}
+
+int connect_unix(const std::string& path) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::perror("connect");
+        std::exit(1);
+    }
+    return fd;
+}
+
+void write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = write(fd, data, size);
+        if (n <= 0) {
+            std::perror("write");
+            std::exit(1);
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+void wait_for(uint64_t count) {
+    while (g_received.load(std::memory_order_acquire) < count) {
+    }
+}
+
+void run(ListenerBackend backend, bool unix_socket, unsigned short port, const std::string& path) {
+    ListenerOptions options;
+    options.backend = backend;
+    if (unix_socket) {
+        options.unix_path = path;
+    } else {
+        options.tcp_port = port;
+    }
+    g_received = 0;
+    const bool started = start_event_listener(options, [](EventMessage, MessageFormat format, uint16_t) {
+        if (format != MessageFormat::End) g_received.fetch_add(1, std::memory_order_release);
+        return true;
+    });
+    if (!started) {
+        std::fprintf(stderr, "listener did not start\n");
+        std::exit(1);
+    }
+
+    const std::string label = std::string(listener_backend_name(backend)) + (unix_socket ? ", unix" : ", tcp");
+    const int fd = unix_socket ? connect_unix(path) : connect_tcp(port);
+
+    bench((label + ", write to sink").c_str(), kRoundTrips, [&] {
+        const uint64_t base = g_received.load();
+        for (size_t i = 1; i <= kRoundTrips; ++i) {
+            write_all(fd, kLine.data(), kLine.size());
+            wait_for(base + i);
+        }
+        return g_received.load();
+    }, 3);
+
+    std::string bulk;
+    for (size_t i = 0; i < 1024; ++i) bulk += kLine;
+    bench((label + ", bulk, per line").c_str(), kBulkLines, [&] {
+        const uint64_t base = g_received.load();
+        for (size_t sent = 0; sent < kBulkLines; sent += 1024) write_all(fd, bulk.data(), bulk.size());
+        wait_for(base + kBulkLines);
+        return g_received.load();
+    }, 3);
+
+    close(fd);
+    stop_event_listener();
+}
+
+} // namespace
+
+int main() {
+    const char* port_env = std::getenv("HOT_CUE_MESH_BENCH_PORT");
+    const auto port = static_cast<unsigned short>(port_env ? std::atoi(port_env) : 47781);
+    const std::string path = "/tmp/hot-cue-mesh-bench-" + std::to_string(getpid()) + ".sock";
+
+    for (const ListenerBackend backend : {ListenerBackend::Epoll, ListenerBackend::IoUring}) {
+        run(backend, false, port, path);
+        run(backend, true, port, path);
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+// ObsStateBench.cpp
+//
+// The /obsState bodies on a large synthetic graph: building an nlohmann
+// document and dump()ing it against JsonWriter (user-024), the nested layout
+// against the normalized one (user-025), and the patch for one visibility
+// change (user-021).
+#include "Bench.hpp"
+#include "ObsStateJson.hpp"
+
+#include <obs-module.h>
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t kScenes = 500;
+constexpr size_t kItemsPerScene = 40;
+constexpr size_t kSources = 2000;
+
+SceneGraphSnapshot synthetic_graph() {
+    std::mt19937 random(20261016);
+    SceneGraphSnapshot snapshot;
+    snapshot.graph_version = 1;
+    NameId next_id = 1;
+    std::vector<NameId> source_ids;
+    for (size_t i = 0; i < kSources; ++i) {
+        auto source = std::make_shared<SourceState>();
+        source->id = next_id++;
+        source->name = "Source " + std::to_string(i) + (i % 7 == 0 ? " \"quoted\"" : "");
+        source->output_flags = (i % 3 == 0 ? OBS_SOURCE_AUDIO : OBS_SOURCE_VIDEO) | OBS_SOURCE_SRGB;
+        const size_t filters = random() % 4;
+        for (size_t f = 0; f < filters; ++f) {
+            source->filters.push_back({next_id++, "Filter " + std::to_string(f), random() % 2 == 0});
+        }
+        source_ids.push_back(source->id);
+        snapshot.sources[source->id] = std::move(source);
+    }
+    for (size_t i = 0; i < kScenes; ++i) {
+        auto scene = std::make_shared<SceneState>();
+        scene->id = next_id++;
+        scene->name = "Scene " + std::to_string(i);
+        for (size_t item = 0; item < kItemsPerScene; ++item) {
+            scene->items.push_back({static_cast<int64_t>(item + 1), source_ids[random() % kSources], random() % 2 == 0});
+        }
+        snapshot.scenes.push_back(std::move(scene));
+    }
+    return snapshot;
+}
+
+} // namespace
+
+int main() {
+    const SceneGraphSnapshot snapshot = synthetic_graph();
+
+    std::string nested;
+    write_obs_state(snapshot, nested);
+    std::string normalized;
+    write_normalized_obs_state(snapshot, normalized);
+    if (nested != build_obs_state(snapshot).dump()) {
+        std::fprintf(stderr, "write_obs_state() differs from dump()\n");
+        return 1;
+    }
+    std::printf("%zu scenes, %zu items, %zu sources: nested body %zu bytes, normalized %zu bytes\n", kScenes,
+                kScenes * kItemsPerScene, kSources, nested.size(), normalized.size());
+
+    bench("nested, nlohmann build + dump()", 1, [&] { return build_obs_state(snapshot).dump().size(); }, 3);
+    bench("nested, write_obs_state()", 1, [&] {
+        std::string body;
+        body.reserve(nested.size());
+        write_obs_state(snapshot, body);
+        return body.size();
+    });
+    bench("normalized, write_normalized_obs_state()", 1, [&] {
+        std::string body;
+        body.reserve(normalized.size());
+        write_normalized_obs_state(snapshot, body);
+        return body.size();
+    });
+
+    // One item flipped: the stream sends a patch instead of a body.
+    SceneGraphSnapshot next = snapshot;
+    auto scene = std::make_shared<SceneState>(*next.scenes[kScenes / 2]);
+    scene->items[0].visible = !scene->items[0].visible;
+    next.scenes[kScenes / 2] = std::move(scene);
+    bench("patch for one visibility change", 1, [&] { return nlohmann::json(diff_obs_state(snapshot, next)).dump().size(); });
+    return 0;
+}
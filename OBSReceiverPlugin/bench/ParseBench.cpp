@@ -0,0 +1,182 @@
+// ParseBench.cpp
+//
+// The ingest path piece by piece: the newline scan (user-010), the command
+// table lookup against a linear scan (user-016), and text lines against binary
+// frames, both parsed alone and through stream framing (user-018).
+#include "Bench.hpp"
+#include "BinaryFraming.hpp"
+#include "CommandTable.hpp"
+#include "LineFraming.hpp"
+#include "ObsEvents.hpp"
+
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void put_name(std::string& out, std::string_view name) {
+    put_varint(out, name.size() << 1);
+    out += name;
+}
+
+// The same two commands as kLine.
+constexpr std::string_view kLine =
+    "show_source -scene_name Scene -source_name Camera; hide_filter -source_name Camera -filter_name Blur";
+
+std::string binary_frame() {
+    std::string frame;
+    frame += static_cast<char>(EventType::ShowSource);
+    frame += static_cast<char>(arg_bit(ArgKey::SceneName) | arg_bit(ArgKey::SourceName));
+    put_name(frame, "Scene");
+    put_name(frame, "Camera");
+    frame += static_cast<char>(EventType::HideFilter);
+    frame += static_cast<char>(arg_bit(ArgKey::SourceName) | arg_bit(ArgKey::FilterName));
+    put_name(frame, "Camera");
+    put_name(frame, "Blur");
+    return frame;
+}
+
+void newline_scan() {
+    // 64-byte lines, as a busy sender would write them.
+    std::string buffer;
+    while (buffer.size() < 1024 * 1024) buffer += std::string(63, 'x') + '\n';
+    const size_t lines = buffer.size() / 64;
+    const char* const end = buffer.data() + buffer.size();
+
+    bench("newline scan, byte loop", lines, [&] {
+        uint64_t found = 0;
+        for (const char* p = buffer.data(); p < end; ++p) found += *p == '\n';
+        return found;
+    });
+    bench("newline scan, memchr", lines, [&] {
+        uint64_t found = 0;
+        for (const char* p = buffer.data(); p < end; ++found) {
+            const void* nl = std::memchr(p, '\n', static_cast<size_t>(end - p));
+            p = nl ? static_cast<const char*>(nl) + 1 : end;
+        }
+        return found;
+    });
+    bench("newline scan, find_newline", lines, [&] {
+        uint64_t found = 0;
+        for (const char* p = buffer.data(); p < end; ++found) {
+            const char* nl = find_newline(p, end);
+            p = nl == end ? end : nl + 1;
+        }
+        return found;
+    });
+}
+
+void command_lookup() {
+    const std::vector<std::string_view> names = {"show_source", "hide_source",  "toggle_source", "show_filter",
+                                                 "hide_filter", "toggle_filter", "switch_scene", "begin",
+                                                 "commit",      "unknown_name"};
+    constexpr size_t kRounds = 200'000;
+    const size_t lookups = kRounds * names.size();
+
+    bench("command lookup, linear scan", lookups, [&] {
+        uint64_t found = 0;
+        for (size_t round = 0; round < kRounds; ++round) {
+            for (const std::string_view name : names) {
+                for (const CommandDef& def : kCommandDefs) {
+                    if (def.name == name) {
+                        found += static_cast<uint64_t>(def.type);
+                        break;
+                    }
+                }
+            }
+        }
+        return found;
+    });
+    bench("command lookup, perfect hash", lookups, [&] {
+        uint64_t found = 0;
+        for (size_t round = 0; round < kRounds; ++round) {
+            for (const std::string_view name : names) {
+                if (const CommandDef* def = find_command_def(name)) found += static_cast<uint64_t>(def->type);
+            }
+        }
+        return found;
+    });
+}
+
+void text_against_binary() {
+    constexpr size_t kRounds = 500'000;
+    const std::string frame = binary_frame();
+    std::vector<EventCommand> commands;
+    commands.reserve(8);
+
+    bench("parse_event_line, per command", kRounds * 2, [&] {
+        uint64_t parsed = 0;
+        for (size_t i = 0; i < kRounds; ++i) {
+            commands.clear();
+            parsed += parse_event_line(kLine, 1, commands);
+        }
+        return parsed;
+    });
+    bench("parse_event_frame, per command", kRounds * 2, [&] {
+        uint64_t parsed = 0;
+        for (size_t i = 0; i < kRounds; ++i) {
+            commands.clear();
+            parsed += parse_event_frame(frame, 1, commands);
+        }
+        return parsed;
+    });
+}
+
+// Bytes as they come off a stream, through LineAssembler and into a sink that
+// parses every message.
+void framed_streams() {
+    constexpr size_t kMessages = 200'000;
+    std::string text;
+    std::string binary(1, static_cast<char>(kBinaryFramingMagic));
+    const std::string frame = binary_frame();
+    for (size_t i = 0; i < kMessages; ++i) {
+        text += kLine;
+        text += '\n';
+        put_varint(binary, frame.size());
+        binary += frame;
+    }
+
+    std::vector<EventCommand> commands;
+    const LineSink sink = [&](EventMessage message, MessageFormat format, uint16_t origin) {
+        commands.clear();
+        if (format == MessageFormat::Line) {
+            parse_event_line(message.view(), origin, commands);
+        } else if (format == MessageFormat::Frame) {
+            parse_event_frame(message.view(), origin, commands);
+        }
+        return true;
+    };
+    // recv()-sized reads.
+    const auto feed = [&](const std::string& stream) {
+        LineAssembler assembler;
+        for (size_t at = 0; at < stream.size(); at += 16 * 1024) {
+            assembler.append(stream.data() + at, std::min<size_t>(16 * 1024, stream.size() - at), sink);
+        }
+        assembler.finish(sink);
+        return static_cast<uint64_t>(commands.size());
+    };
+
+    std::printf("stream of %zu messages: %zu bytes as text, %zu as binary\n", kMessages, text.size(), binary.size());
+    bench("text stream, framed and parsed, per command", kMessages * 2, [&] { return feed(text); });
+    bench("binary stream, framed and parsed, per command", kMessages * 2, [&] { return feed(binary); });
+}
+
+} // namespace
+
+int main() {
+    newline_scan();
+    command_lookup();
+    text_against_binary();
+    framed_streams();
+    return 0;
+}
@@ -0,0 +1,225 @@
+// ChannelTest.cpp
+//
+// EventChannel's overflow policies: what a full lane does with the next
+// command, and that the coalescing side table keeps every origin's lines and
+// groups intact.
+#include "Channel.hpp"
+#include "TestCheck.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// stamp tells the commands apart once popped.
+EventCommand command(EventType type, NameId source, uint16_t origin, uint64_t stamp, bool ends_line = true) {
+    EventCommand c;
+    c.type = type;
+    c.flags = ends_line ? kCommandEndsLine : 0;
+    c.origin = origin;
+    c.source = source;
+    c.received_ns = stamp;
+    return c;
+}
+
+EventCommand show(NameId source, uint16_t origin, uint64_t stamp, bool ends_line = true) {
+    return command(EventType::ShowSource, source, origin, stamp, ends_line);
+}
+
+constexpr uint16_t kFillerOrigin = 99;
+
+// Fills the ring, so everything after goes to the overflow policy.
+void fill(EventChannel& channel) {
+    for (size_t i = 0; i < channel.capacity(); ++i) {
+        CHECK(channel.push(show(static_cast<NameId>(1000 + i), kFillerOrigin, 0)));
+    }
+}
+
+// Everything queued in Lane::Normal, but the commands fill() put there.
+std::vector<EventCommand> drain(EventChannel& channel) {
+    std::vector<EventCommand> out;
+    EventCommand c;
+    while (channel.try_pop(Lane::Normal, c)) {
+        if (c.origin != kFillerOrigin) out.push_back(c);
+    }
+    return out;
+}
+
+void drop_newest_rejects_the_incoming_command() {
+    EventChannel channel({2, OverflowPolicy::DropNewest});
+    CHECK(channel.push(show(1, 1, 1)));
+    CHECK(channel.push(show(2, 1, 2)));
+    CHECK(!channel.push(show(3, 1, 3)));
+    const std::vector<EventCommand> out = drain(channel);
+    CHECK(out.size() == 2 && out[0].received_ns == 1 && out[1].received_ns == 2);
+    const LaneStats stats = channel.stats().lanes[static_cast<size_t>(Lane::Normal)];
+    CHECK(stats.accepted == 2 && stats.dropped == 1 && stats.high_water == 2);
+}
+
+void drop_oldest_evicts_the_front() {
+    EventChannel channel({2, OverflowPolicy::DropOldest});
+    for (uint64_t stamp = 1; stamp <= 3; ++stamp) CHECK(channel.push(show(1, 1, stamp)));
+    const std::vector<EventCommand> out = drain(channel);
+    CHECK(out.size() == 2 && out[0].received_ns == 2 && out[1].received_ns == 3);
+    CHECK(channel.stats().lanes[static_cast<size_t>(Lane::Normal)].dropped == 1);
+}
+
+void block_waits_for_room() {
+    EventChannel channel({2, OverflowPolicy::Block});
+    fill(channel);
+    std::atomic<bool> pushed{false};
+    std::thread producer([&] {
+        CHECK(channel.push(show(1, 1, 1)));
+        pushed = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(!pushed);
+    EventCommand c;
+    CHECK(channel.try_pop(Lane::Normal, c));
+    producer.join();
+    CHECK(pushed && drain(channel).size() == 1);
+
+    // close() releases a producer that is still waiting.
+    fill(channel);
+    std::thread late([&] { CHECK(!channel.push(show(1, 1, 1))); });
+    channel.close();
+    late.join();
+}
+
+void lanes_overflow_separately() {
+    EventChannel channel({2, OverflowPolicy::DropNewest});
+    fill(channel);
+    EventCommand high = show(1, 1, 1);
+    high.flags |= kCommandHighPriority;
+    CHECK(channel.push(high));
+    EventCommand c;
+    CHECK(channel.try_pop(c) && c.received_ns == 1);
+}
+
+void coalesce_replaces_within_a_line() {
+    EventChannel channel({8, OverflowPolicy::CoalesceByKey});
+    fill(channel);
+    // One line: show A, hide A, show B.
+    CHECK(channel.push(show(1, 1, 1, false)));
+    CHECK(channel.push(command(EventType::HideSource, 1, 1, 2, false)));
+    CHECK(channel.push(show(2, 1, 3)));
+    const std::vector<EventCommand> out = drain(channel);
+    CHECK(out.size() == 2);
+    CHECK(out.size() == 2 && out[0].type == EventType::HideSource && out[0].received_ns == 2 &&
+          !(out[0].flags & kCommandEndsLine));
+    CHECK(out.size() == 2 && out[1].received_ns == 3 && (out[1].flags & kCommandEndsLine));
+    CHECK(channel.stats().lanes[static_cast<size_t>(Lane::Normal)].coalesced == 1);
+}
+
+void coalesce_keeps_the_line_end_of_the_parked_command() {
+    EventChannel channel({8, OverflowPolicy::CoalesceByKey});
+    fill(channel);
+    // Line one: show B, show A. Line two, then three: hide A.
+    CHECK(channel.push(show(2, 1, 1, false)));
+    CHECK(channel.push(show(1, 1, 2)));
+    CHECK(channel.push(command(EventType::HideSource, 1, 1, 3)));
+    CHECK(channel.push(command(EventType::ShowSource, 1, 1, 4)));
+    const std::vector<EventCommand> out = drain(channel);
+    CHECK(out.size() == 2);
+    CHECK(out.size() == 2 && out[1].received_ns == 4 && (out[1].flags & kCommandEndsLine));
+    CHECK(channel.stats().lanes[static_cast<size_t>(Lane::Normal)].coalesced == 2);
+}
+
+void coalesce_never_pulls_a_line_into_the_one_before() {
+    EventChannel channel({8, OverflowPolicy::CoalesceByKey});
+    fill(channel);
+    // Line one ends with show A; line two starts with hide A.
+    CHECK(channel.push(show(1, 1, 1)));
+    CHECK(channel.push(command(EventType::HideSource, 1, 1, 2, false)));
+    CHECK(channel.push(show(2, 1, 3)));
+    const std::vector<EventCommand> out = drain(channel);
+    CHECK(out.size() == 3);
+    CHECK(out.size() == 3 && out[0].received_ns == 1 && (out[0].flags & kCommandEndsLine));
+    CHECK(out.size() == 3 && out[1].received_ns == 2 && !(out[1].flags & kCommandEndsLine));
+}
+
+void coalesce_never_crosses_origins() {
+    EventChannel channel({8, OverflowPolicy::CoalesceByKey});
+    fill(channel);
+    CHECK(channel.push(show(1, 1, 1, false)));
+    CHECK(channel.push(command(EventType::HideSource, 1, 2, 2)));
+    CHECK(channel.push(show(2, 1, 3)));
+    const std::vector<EventCommand> out = drain(channel);
+    CHECK(out.size() == 3);
+    CHECK(out.size() == 3 && out[0].origin == 1 && out[0].type == EventType::ShowSource &&
+          !(out[0].flags & kCommandEndsLine));
+    CHECK(out.size() == 3 && out[1].origin == 2 && (out[1].flags & kCommandEndsLine));
+    CHECK(out.size() == 3 && out[2].origin == 1 && (out[2].flags & kCommandEndsLine));
+}
+
+void coalesce_keeps_group_markers_between() {
+    EventChannel channel({8, OverflowPolicy::CoalesceByKey});
+    fill(channel);
+    CHECK(channel.push(show(1, 1, 1, false)));
+    CHECK(channel.push(command(EventType::BeginBatch, kNoName, 1, 2)));
+    CHECK(channel.push(command(EventType::HideSource, 1, 1, 3)));
+    CHECK(channel.push(command(EventType::CommitBatch, kNoName, 1, 4)));
+    CHECK(drain(channel).size() == 4);
+}
+
+void toggles_are_never_coalesced() {
+    EventChannel channel({8, OverflowPolicy::CoalesceByKey});
+    fill(channel);
+    CHECK(channel.push(command(EventType::ToggleSource, 1, 1, 1, false)));
+    CHECK(channel.push(command(EventType::ToggleSource, 1, 1, 2)));
+    CHECK(drain(channel).size() == 2);
+    CHECK(channel.stats().lanes[static_cast<size_t>(Lane::Normal)].coalesced == 0);
+}
+
+// The side table keeps working once its front has been popped, and the ring
+// only gets new commands again after the side table ran dry.
+void coalesce_after_partial_drain() {
+    EventChannel channel({4, OverflowPolicy::CoalesceByKey});
+    fill(channel);
+    for (NameId source = 1; source <= 4; ++source) CHECK(channel.push(show(source, source, source)));
+
+    EventCommand c;
+    for (int i = 0; i < 6; ++i) CHECK(channel.try_pop(Lane::Normal, c));
+    CHECK(c.received_ns == 2);
+    // Source 4 is origin 4's latest parked command.
+    CHECK(channel.push(command(EventType::HideSource, 4, 4, 40)));
+    // Source 2 was popped already.
+    CHECK(channel.push(command(EventType::HideSource, 2, 2, 20)));
+
+    const std::vector<EventCommand> out = drain(channel);
+    CHECK(out.size() == 3);
+    CHECK(out.size() == 3 && out[0].received_ns == 3);
+    CHECK(out.size() == 3 && out[1].received_ns == 40 && out[1].type == EventType::HideSource);
+    CHECK(out.size() == 3 && out[2].received_ns == 20);
+    CHECK(channel.push(show(1, 1, 1)) && channel.try_pop(Lane::Normal, c) && c.received_ns == 1);
+}
+
+void coalesce_stays_bounded() {
+    EventChannel channel({2, OverflowPolicy::CoalesceByKey});
+    fill(channel);
+    CHECK(channel.push(show(1, 1, 1)));
+    CHECK(channel.push(show(2, 2, 2)));
+    CHECK(!channel.push(show(3, 3, 3)));
+    CHECK(channel.stats().lanes[static_cast<size_t>(Lane::Normal)].dropped == 1);
+}
+
+} // namespace
+
+int main() {
+    drop_newest_rejects_the_incoming_command();
+    drop_oldest_evicts_the_front();
+    block_waits_for_room();
+    lanes_overflow_separately();
+    coalesce_replaces_within_a_line();
+    coalesce_keeps_the_line_end_of_the_parked_command();
+    coalesce_never_pulls_a_line_into_the_one_before();
+    coalesce_never_crosses_origins();
+    coalesce_keeps_group_markers_between();
+    toggles_are_never_coalesced();
+    coalesce_after_partial_drain();
+    coalesce_stays_bounded();
+
+    return test_result("channel");
+}
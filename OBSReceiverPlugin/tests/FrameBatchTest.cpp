@@ -0,0 +1,329 @@
+// FrameBatchTest.cpp
+//
+// Feeds event lines through the same parse -> EventBatch -> execute path as
+// the plugin's tick, against the mock libobs, and checks the frame every
+// change lands on: all commands of a line or of a begin/commit group must
+// show up on one frame, however the tick happens to drain them.
+#include "LineFraming.hpp"
+#include "MockObs.hpp"
+#include "ObsEvents.hpp"
+#include "TestCheck.hpp"
+
+#include <obs-module.h>
+#include <util/platform.h>
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// Stands in for the channel and the plugin's tick: commands queue up per
+// lane, and every tick takes at most budget of them, high lane first.
+class Pipeline {
+public:
+    explicit Pipeline(size_t budget) : budget_(budget) {}
+
+    void send(std::string_view line, uint16_t origin) {
+        std::vector<EventCommand> commands;
+        parse_event_line(line, origin, commands);
+        queue(commands);
+    }
+
+    void end(uint16_t origin) {
+        std::vector<EventCommand> commands;
+        end_event_origin(origin, commands);
+        queue(commands);
+    }
+
+    // One tick and the frame it renders.
+    void frame() {
+        if (batch_.empty()) {
+            batch_.clear();
+            size_t taken = 0;
+            for (const Lane lane_id : {Lane::High, Lane::Normal}) {
+                std::deque<EventCommand>& lane = lanes_[static_cast<size_t>(lane_id)];
+                while (taken < budget_ && !lane.empty()) {
+                    batch_.add(lane.front(), os_gettime_ns());
+                    lane.pop_front();
+                    ++taken;
+                }
+            }
+            batch_.seal(os_gettime_ns(), os_gettime_ns() + obs_get_frame_interval_ns() / 2);
+        }
+        batch_.execute_until(std::chrono::steady_clock::time_point::max());
+        render_mock_frame();
+    }
+
+    const EventBatch& batch() const { return batch_; }
+
+private:
+    void queue(const std::vector<EventCommand>& commands) {
+        for (const EventCommand& command : commands) {
+            lanes_[static_cast<size_t>(lane_of(command))].push_back(command);
+        }
+    }
+
+    size_t budget_;
+    std::deque<EventCommand> lanes_[kLaneCount];
+    EventBatch batch_;
+};
+
+bool same_frame(const std::vector<MockChange>& changes, size_t expected_count) {
+    if (changes.size() != expected_count) return false;
+    for (const MockChange& change : changes) {
+        if (change.frame != changes.front().frame) return false;
+    }
+    return true;
+}
+
+void line_split_across_ticks_lands_on_one_frame() {
+    reset_mock_obs();
+    Pipeline pipeline(2);
+    pipeline.send("show_source -source_name A; show_source -source_name B; show_source -source_name C", 1);
+    pipeline.frame();
+    CHECK(take_mock_changes().empty());
+    pipeline.frame();
+    const std::vector<MockChange> changes = take_mock_changes();
+    CHECK(same_frame(changes, 3));
+    CHECK(!changes.empty() && changes.front().frame == 1);
+}
+
+void group_spanning_lines_lands_on_one_frame() {
+    reset_mock_obs();
+    Pipeline pipeline(64);
+    pipeline.send("begin; show_source -source_name A", 1);
+    pipeline.frame();
+    pipeline.send("show_filter -source_name A -filter_name F", 1);
+    pipeline.frame();
+    CHECK(take_mock_changes().empty());
+    pipeline.send("show_source -source_name B; commit", 1);
+    pipeline.frame();
+    const std::vector<MockChange> changes = take_mock_changes();
+    CHECK(same_frame(changes, 3));
+    CHECK(!changes.empty() && changes.front().frame == 2);
+}
+
+// The rest of the line is applied on the tick; only the switch goes to the UI
+// thread, without the graphics lock, and the next unit waits for it.
+void scene_switch_goes_to_the_ui_thread_unlocked() {
+    reset_mock_obs();
+    Pipeline pipeline(64);
+    pipeline.send("switch_scene -scene_name S; show_source -source_name A", 1);
+    pipeline.send("show_source -source_name B", 1);
+    pipeline.frame();
+    std::vector<MockChange> changes = take_mock_changes();
+    CHECK(same_frame(changes, 2));
+    CHECK(changes.size() == 2 && changes[0].what == "show A" && !changes[0].in_ui_task);
+    CHECK(changes.size() == 2 && changes[1].what == "scene S" && changes[1].in_ui_task);
+    for (const MockChange& change : changes) {
+        CHECK(!change.in_graphics);
+    }
+
+    pipeline.frame();
+    changes = take_mock_changes();
+    CHECK(changes.size() == 1 && changes.front().what == "show B" && changes.front().frame == 1);
+}
+
+void groups_of_other_origins_stay_apart() {
+    reset_mock_obs();
+    Pipeline pipeline(64);
+    pipeline.send("begin; show_source -source_name A", 1);
+    pipeline.send("show_source -source_name B", 2);
+    pipeline.frame();
+    std::vector<MockChange> changes = take_mock_changes();
+    CHECK(changes.size() == 1 && changes.front().what == "show B");
+
+    pipeline.send("show_source -source_name C; commit", 1);
+    pipeline.frame();
+    changes = take_mock_changes();
+    CHECK(same_frame(changes, 2));
+    CHECK(changes.size() == 2 && changes[0].what == "show A" && changes[1].what == "show C");
+}
+
+void ended_origin_drops_its_open_group() {
+    reset_mock_obs();
+    Pipeline pipeline(64);
+    pipeline.send("begin; show_source -source_name A", 1);
+    pipeline.frame();
+    pipeline.end(1);
+    pipeline.frame();
+    CHECK(pipeline.batch().abandoned_groups() == 1);
+
+    // The origin may be handed out again; its next line starts afresh.
+    pipeline.send("show_source -source_name B", 1);
+    pipeline.frame();
+    const std::vector<MockChange> changes = take_mock_changes();
+    CHECK(changes.size() == 1 && changes.front().what == "show B");
+}
+
+// A group's lane follows the lines of its own origin only.
+void group_lane_is_kept_per_origin() {
+    std::vector<EventCommand> commands;
+    parse_event_line("begin -priority high; show_source -source_name A", 1, commands);
+    parse_event_line("show_source -source_name B", 2, commands);
+    parse_event_line("show_source -source_name C", 1, commands);
+    CHECK(commands.size() == 4);
+    CHECK(lane_of(commands[1]) == Lane::High);
+    CHECK(lane_of(commands[2]) == Lane::Normal);
+    CHECK(lane_of(commands[3]) == Lane::High);
+
+    commands.clear();
+    CHECK(end_event_origin(2, commands) == 0);
+    CHECK(end_event_origin(1, commands) == 1 && lane_of(commands.back()) == Lane::High);
+    // Forgotten: the origin's next line picks its own lane again.
+    parse_event_line("show_source -source_name D", 1, commands);
+    CHECK(lane_of(commands.back()) == Lane::Normal);
+}
+
+// Offsets too large for the timer wheel are rejected, not wrapped around.
+void far_offsets_are_rejected() {
+    std::vector<EventCommand> commands;
+    CHECK(parse_event_line("show_source -source_name A -in_ms 18446744073709551615", 1, commands) == 0);
+    CHECK(parse_event_line("show_source -source_name A -ttl_ms 18446744073709551615", 1, commands) == 0);
+    CHECK(parse_event_line("show_source -source_name A -at_ns 18446744073709551615", 1, commands) == 0);
+    CHECK(parse_event_line("show_source -source_name A -in_ms 60000 -ttl_ms 60000", 1, commands) == 1);
+    CHECK(commands.size() == 1 && commands[0].due_ns > commands[0].received_ns &&
+          commands[0].expires_ns > commands[0].due_ns);
+}
+
+// Two connections, their bytes interleaved on one listener thread; the second
+// one hangs up inside a group.
+void connections_are_origins_of_their_own() {
+    reset_mock_obs();
+    Pipeline pipeline(64);
+    const LineSink sink = [&](EventMessage message, MessageFormat format, uint16_t origin) {
+        if (format == MessageFormat::End) {
+            pipeline.end(origin);
+        } else {
+            pipeline.send(message.view(), origin);
+        }
+        return true;
+    };
+
+    LineAssembler first;
+    LineAssembler second;
+    CHECK(first.origin() != 0 && second.origin() != 0 && first.origin() != second.origin());
+
+    const std::string opening = "begin\nshow_source -source_name A\n";
+    const std::string other = "show_source -source_name B\nbegin\nshow_source -source_name C\n";
+    CHECK(first.append(opening.data(), opening.size(), sink));
+    CHECK(second.append(other.data(), other.size(), sink));
+    CHECK(second.finish(sink));
+    pipeline.frame();
+    std::vector<MockChange> changes = take_mock_changes();
+    CHECK(changes.size() == 1 && changes.front().what == "show B");
+
+    const std::string closing = "show_source -source_name D\ncommit\n";
+    CHECK(first.append(closing.data(), closing.size(), sink));
+    pipeline.frame();
+    changes = take_mock_changes();
+    CHECK(same_frame(changes, 2));
+    CHECK(changes.size() == 2 && changes[0].what == "show A" && changes[1].what == "show D");
+    CHECK(pipeline.batch().abandoned_groups() == 1);
+}
+
+std::vector<std::string> changed(const std::vector<MockChange>& changes) {
+    std::vector<std::string> what;
+    for (const MockChange& change : changes) what.push_back(change.what);
+    return what;
+}
+
+// Commands on one target fold into the last of them: show then hide is a hide,
+// two toggles cancel, the last scene switch wins.
+void batch_coalesces_per_target() {
+    reset_mock_obs();
+    Pipeline pipeline(64);
+    pipeline.send("show_source -source_name A; hide_source -source_name A", 1);
+    pipeline.send("toggle_source -source_name B", 2);
+    pipeline.send("toggle_source -source_name B", 1);
+    pipeline.send("toggle_source -source_name C; toggle_source -source_name C; toggle_source -source_name C", 1);
+    pipeline.send("show_filter -source_name A -filter_name F; toggle_filter -source_name A -filter_name F", 1);
+    pipeline.send("switch_scene -scene_name S; switch_scene -scene_name T", 1);
+    // The switch is in the high lane and goes first; the rest waits for its
+    // UI task.
+    pipeline.frame();
+    pipeline.frame();
+    CHECK(changed(take_mock_changes()) == (std::vector<std::string>{"scene T", "hide A", "show C", "disable F"}));
+    CHECK(pipeline.batch().coalesced() == 7);
+}
+
+void coalescing_keeps_to_one_target_and_batch() {
+    reset_mock_obs();
+    Pipeline pipeline(64);
+    pipeline.send("show_source -scene_name X -source_name A; hide_source -scene_name Y -source_name A", 1);
+    pipeline.send("show_filter -source_name A -filter_name F; hide_filter -source_name B -filter_name F", 1);
+    pipeline.frame();
+    CHECK(changed(take_mock_changes()) == (std::vector<std::string>{"show A", "hide A", "enable F", "disable F"}));
+
+    pipeline.send("toggle_source -source_name B", 1);
+    pipeline.frame();
+    pipeline.send("toggle_source -source_name B", 1);
+    pipeline.frame();
+    CHECK(changed(take_mock_changes()) == (std::vector<std::string>{"show B", "hide B"}));
+    CHECK(pipeline.batch().coalesced() == 0);
+}
+
+// One command, received at received_ns, added and run at now_ns; returns
+// whether it was applied.
+bool applied(EventBatch& batch, std::string_view line, uint64_t received_ns, uint64_t now_ns) {
+    std::vector<EventCommand> commands;
+    parse_event_line(line, 1, commands);
+    CHECK(commands.size() == 1);
+    if (commands[0].expires_ns != 0) commands[0].expires_ns += received_ns - commands[0].received_ns;
+    commands[0].received_ns = received_ns;
+    take_mock_changes();
+    batch.add(commands[0], now_ns);
+    batch.seal(now_ns, now_ns);
+    batch.execute_until(std::chrono::steady_clock::time_point::max());
+    batch.clear();
+    return !take_mock_changes().empty();
+}
+
+void stale_commands_are_dropped() {
+    reset_mock_obs();
+    constexpr uint64_t kSecond = 1'000'000'000;
+    EventBatch batch;
+    batch.set_ttl(EventType::ToggleSource, kSecond / 2);
+    CHECK(!applied(batch, "toggle_source -source_name A", kSecond, 2 * kSecond));
+    CHECK(applied(batch, "toggle_source -source_name A", kSecond, kSecond + kSecond / 4));
+    CHECK(batch.expired(EventType::ToggleSource) == 1);
+    // No TTL for show_source.
+    CHECK(applied(batch, "show_source -source_name A", kSecond, 100 * kSecond));
+
+    // The largest TTL never expires anything, and never wraps around.
+    batch.set_ttl(EventType::ShowSource, UINT64_MAX);
+    CHECK(applied(batch, "show_source -source_name A", kSecond, 100 * kSecond));
+    CHECK(batch.expired(EventType::ShowSource) == 0);
+}
+
+// -ttl_ms counts from arrival.
+void sender_ttl_is_honoured() {
+    reset_mock_obs();
+    constexpr uint64_t kMs = 1'000'000;
+    EventBatch batch;
+    CHECK(applied(batch, "show_source -source_name A -ttl_ms 100", 1000 * kMs, 1050 * kMs));
+    CHECK(!applied(batch, "show_source -source_name A -ttl_ms 100", 1000 * kMs, 1101 * kMs));
+    CHECK(batch.expired(EventType::ShowSource) == 1);
+}
+
+} // namespace
+
+int main() {
+    line_split_across_ticks_lands_on_one_frame();
+    group_spanning_lines_lands_on_one_frame();
+    scene_switch_goes_to_the_ui_thread_unlocked();
+    groups_of_other_origins_stay_apart();
+    ended_origin_drops_its_open_group();
+    group_lane_is_kept_per_origin();
+    far_offsets_are_rejected();
+    connections_are_origins_of_their_own();
+    batch_coalesces_per_target();
+    coalescing_keeps_to_one_target_and_batch();
+    stale_commands_are_dropped();
+    sender_ttl_is_honoured();
+
+    return test_result("frame batch");
+}
@@ -0,0 +1,166 @@
+// MockObs.cpp
+#include "MockObs.hpp"
+#include "SourceCache.hpp"
+
+#include <obs-frontend-api.h>
+#include <obs-module.h>
+#include <util/platform.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <utility>
+
+struct obs_source {
+    std::string name;
+    bool enabled = true;
+};
+
+struct obs_scene_item {
+    std::string name;
+    bool visible = false;
+};
+
+namespace {
+
+constexpr uint64_t kFrameIntervalNs = 16'666'667;
+constexpr uint64_t kStartNs = 1'000'000'000;
+
+struct MockObs {
+    uint64_t frame = 0;
+    uint64_t now_ns = kStartNs;
+    int graphics_depth = 0;
+    bool in_ui_task = false;
+    std::vector<MockChange> changes;
+    std::vector<std::pair<obs_task_t, void*>> ui_tasks;
+    // Owned here; the plugin's references are never counted.
+    std::map<std::string, std::unique_ptr<obs_source>> sources;
+    std::map<std::string, std::unique_ptr<obs_scene_item>> items;
+};
+
+MockObs g_obs;
+
+void record(std::string what) {
+    g_obs.changes.push_back(MockChange{std::move(what), g_obs.frame, g_obs.graphics_depth > 0, g_obs.in_ui_task});
+}
+
+obs_source* mock_source(NameId name) {
+    std::unique_ptr<obs_source>& source = g_obs.sources[std::string(name_view(name))];
+    if (!source) source = std::make_unique<obs_source>(obs_source{std::string(name_view(name))});
+    return source.get();
+}
+
+} // namespace
+
+std::vector<MockChange> take_mock_changes() {
+    return std::exchange(g_obs.changes, {});
+}
+
+uint64_t mock_frame() {
+    return g_obs.frame;
+}
+
+void render_mock_frame() {
+    g_obs.in_ui_task = true;
+    for (const auto& [task, param] : std::exchange(g_obs.ui_tasks, {})) {
+        task(param);
+    }
+    g_obs.in_ui_task = false;
+    ++g_obs.frame;
+    g_obs.now_ns += kFrameIntervalNs;
+}
+
+void reset_mock_obs() {
+    g_obs = MockObs();
+}
+
+// Every scene, item and filter exists, named as asked; scene is ignored, so
+// an item is the same object in every scene.
+ObsSourcePtr resolve_scene(NameId scene) {
+    return ObsSourcePtr(mock_source(scene));
+}
+
+ObsSceneItemPtr resolve_scene_item(NameId scene, NameId source) {
+    static_cast<void>(scene);
+    std::unique_ptr<obs_scene_item>& item = g_obs.items[std::string(name_view(source))];
+    if (!item) item = std::make_unique<obs_scene_item>(obs_scene_item{std::string(name_view(source)), false});
+    return ObsSceneItemPtr(item.get());
+}
+
+ObsSourcePtr resolve_filter(NameId source, NameId filter) {
+    static_cast<void>(source);
+    return ObsSourcePtr(mock_source(filter));
+}
+
+uint64_t scene_graph_version() {
+    return 1;
+}
+
+extern "C" {
+
+void blog(int log_level, const char* format, ...) {
+    static_cast<void>(log_level);
+    va_list args;
+    va_start(args, format);
+    std::vfprintf(stderr, format, args);
+    va_end(args);
+    std::fputc('\n', stderr);
+}
+
+uint64_t os_gettime_ns(void) {
+    return g_obs.now_ns;
+}
+
+uint64_t obs_get_frame_interval_ns(void) {
+    return kFrameIntervalNs;
+}
+
+void obs_queue_task(enum obs_task_type type, obs_task_t task, void* param, bool wait) {
+    if (type == OBS_TASK_UI && !wait) {
+        g_obs.ui_tasks.emplace_back(task, param);
+    } else {
+        task(param);
+    }
+}
+
+void obs_enter_graphics(void) {
+    ++g_obs.graphics_depth;
+}
+
+void obs_leave_graphics(void) {
+    --g_obs.graphics_depth;
+}
+
+void obs_source_release(obs_source_t* source) {
+    static_cast<void>(source);
+}
+
+bool obs_source_enabled(const obs_source_t* source) {
+    return source->enabled;
+}
+
+void obs_source_set_enabled(obs_source_t* source, bool enabled) {
+    source->enabled = enabled;
+    record((enabled ? "enable " : "disable ") + source->name);
+}
+
+void obs_sceneitem_release(obs_sceneitem_t* item) {
+    static_cast<void>(item);
+}
+
+bool obs_sceneitem_visible(const obs_sceneitem_t* item) {
+    return item->visible;
+}
+
+bool obs_sceneitem_set_visible(obs_sceneitem_t* item, bool visible) {
+    item->visible = visible;
+    record((visible ? "show " : "hide ") + item->name);
+    return true;
+}
+
+void obs_frontend_set_current_scene(obs_source_t* scene) {
+    record("scene " + scene->name);
+}
+
+} // extern "C"
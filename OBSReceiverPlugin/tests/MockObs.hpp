@@ -0,0 +1,31 @@
+// MockObs.hpp
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Test side of the mock libobs in mock_obs/. Every visibility, filter or
+// program scene change is recorded with the index of the frame it would show
+// up on, so a test can tell whether commands meant to land together did.
+
+struct MockChange {
+    std::string what; // "show A", "hide A", "enable F", "disable F", "scene S"
+    uint64_t frame = 0;
+    bool in_graphics = false; // applied while holding the graphics context
+    bool in_ui_task = false;  // applied by an OBS_TASK_UI task
+};
+
+// Changes recorded since the last call, oldest first.
+std::vector<MockChange> take_mock_changes();
+
+// The frame the next tick belongs to; starts at 0.
+uint64_t mock_frame();
+
+// Renders the current frame: first runs the UI tasks queued so far, as if the
+// UI thread got to them before the render thread drew the frame, then moves
+// on to the next frame and the clock by one frame interval.
+void render_mock_frame();
+
+// Forgets every object, change and queued task, and rewinds to frame 0.
+void reset_mock_obs();
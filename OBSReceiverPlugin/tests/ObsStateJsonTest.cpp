@@ -0,0 +1,254 @@
+// ObsStateJsonTest.cpp
+//
+// The /obsState bodies: JsonWriter against nlohmann's dump(), the default
+// document against its nlohmann reference, the normalized layout, and the
+// /obsState/stream patches, which applied to the document of one snapshot
+// must give that of the next.
+#include "JsonWriter.hpp"
+#include "ObsStateJson.hpp"
+#include "TestCheck.hpp"
+
+#include <obs-module.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using nlohmann::json;
+
+std::shared_ptr<const SourceState> source(NameId id, std::string name, uint32_t flags = OBS_SOURCE_VIDEO,
+                                          std::vector<FilterState> filters = {}) {
+    return std::make_shared<const SourceState>(SourceState{id, std::move(name), flags, std::move(filters)});
+}
+
+std::shared_ptr<const SceneState> scene(NameId id, std::string name, std::vector<SceneItemState> items) {
+    return std::make_shared<const SceneState>(SceneState{id, std::move(name), std::move(items)});
+}
+
+SceneItemState item(NameId source, bool visible = true) {
+    static int64_t next_item_id = 1;
+    return SceneItemState{next_item_id++, source, visible};
+}
+
+void add(SceneGraphSnapshot& snapshot, std::shared_ptr<const SourceState> source) {
+    snapshot.sources[source->id] = std::move(source);
+}
+
+// Two scenes sharing a camera; source 9 is not in the model, as for an item
+// whose source the model has not caught up with.
+SceneGraphSnapshot sample() {
+    SceneGraphSnapshot snapshot;
+    snapshot.revision = 1;
+    snapshot.graph_version = 3;
+    add(snapshot, source(1, "Cam \"front\"", OBS_SOURCE_VIDEO | OBS_SOURCE_ASYNC | (1u << 4) | (1u << 31),
+                         {{10, "Blur", true}, {11, "Colour\\Key", false}}));
+    add(snapshot, source(2, "Mic\t1", OBS_SOURCE_AUDIO | OBS_SOURCE_MONITOR_BY_DEFAULT));
+    add(snapshot, source(3, "Übergang ✓"));
+    snapshot.scenes = {
+        scene(20, "Main", {item(1), item(2, false), item(9)}),
+        scene(21, "Break\n", {item(3), item(1, false)}),
+    };
+    return snapshot;
+}
+
+std::string written(const SceneGraphSnapshot& snapshot) {
+    std::string out;
+    write_obs_state(snapshot, out);
+    return out;
+}
+
+void json_writer_matches_dump() {
+    std::string every_byte;
+    for (int c = 1; c < 0x80; ++c) every_byte += static_cast<char>(c);
+    const std::string strings[] = {"", every_byte, std::string("nul\0inside", 10), "é → 😀"};
+
+    std::string out;
+    JsonWriter writer(out);
+    json reference = json::object();
+    writer.begin_object();
+    writer.key("a");
+    writer.begin_array();
+    for (const std::string& text : strings) writer.string_value(text);
+    writer.end_array();
+    writer.key("b");
+    writer.begin_object();
+    writer.end_object();
+    writer.key("c");
+    writer.begin_array();
+    writer.uint_value(0);
+    writer.uint_value(9);
+    writer.uint_value(UINT64_MAX);
+    writer.bool_value(true);
+    writer.bool_value(false);
+    writer.begin_array();
+    writer.end_array();
+    writer.begin_object();
+    writer.key(every_byte);
+    writer.uint_value(10);
+    writer.end_object();
+    writer.end_array();
+    writer.end_object();
+
+    reference["a"] = json::array();
+    for (const std::string& text : strings) reference["a"].push_back(text);
+    reference["b"] = json::object();
+    reference["c"] = {uint64_t{0}, uint64_t{9}, UINT64_MAX, true, false, json::array(), {{every_byte, 10}}};
+    CHECK(out == reference.dump());
+}
+
+void obs_state_matches_the_reference() {
+    const SceneGraphSnapshot snapshot = sample();
+    const json reference = build_obs_state(snapshot);
+    CHECK(written(snapshot) == reference.dump());
+
+    CHECK(reference["version"] == 3);
+    CHECK(reference["scenes"].size() == 2 && reference["scenes"][0]["sources"].size() == 2);
+    CHECK(reference["scenes"][0]["sources"][0]["sourceFlags"] == json({"OBS_SOURCE_VIDEO", "OBS_SOURCE_ASYNC"}));
+    CHECK(reference["scenes"][0]["sources"][1]["visible"] == false);
+
+    // Appends, and copes with an empty graph.
+    std::string out = "x";
+    write_obs_state(SceneGraphSnapshot{}, out);
+    CHECK(out == "x" + build_obs_state(SceneGraphSnapshot{}).dump());
+}
+
+void normalized_lists_each_source_once() {
+    std::string out;
+    write_normalized_obs_state(sample(), out);
+    const json state = json::parse(out);
+
+    CHECK(state["format"] == "normalized" && state["version"] == 3);
+    CHECK(state["sourceFlags"].size() == 17 && state["sourceFlags"]["OBS_SOURCE_VIDEO"] == OBS_SOURCE_VIDEO &&
+          state["sourceFlags"]["OBS_SOURCE_REQUIRES_CANVAS"] == OBS_SOURCE_REQUIRES_CANVAS);
+
+    const json& sources = state["sources"];
+    CHECK(sources.size() == 3);
+    CHECK(sources.size() == 3 && sources[0]["id"] == 1 && sources[1]["id"] == 2 && sources[2]["id"] == 3);
+    CHECK(sources.size() == 3 && sources[0]["name"] == "Cam \"front\"" && sources[2]["name"] == "Übergang ✓");
+    // Unnamed flag bits are cut off.
+    CHECK(sources.size() == 3 && sources[0]["flags"] == (OBS_SOURCE_VIDEO | OBS_SOURCE_ASYNC));
+    CHECK(sources.size() == 3 && sources[0]["filters"].size() == 2 && sources[0]["filters"][1]["enabled"] == false);
+
+    const json& scenes = state["scenes"];
+    CHECK(scenes.size() == 2);
+    CHECK(scenes.size() == 2 && scenes[0]["items"] == json::parse(R"([{"source":1,"visible":true},
+                                                                       {"source":2,"visible":false}])"));
+    CHECK(scenes.size() == 2 && scenes[1]["name"] == "Break\n" && scenes[1]["items"].size() == 2);
+}
+
+// Applying the patch from one snapshot to the next gives the next document;
+// returns the patch.
+json checked_patch(const SceneGraphSnapshot& from, const SceneGraphSnapshot& to) {
+    const json patch(diff_obs_state(from, to));
+    try {
+        CHECK(build_obs_state(from).patch(patch) == build_obs_state(to));
+    } catch (const json::exception&) {
+        // An op whose path is not in the document.
+        CHECK(false);
+    }
+    return patch;
+}
+
+void replace_scene(SceneGraphSnapshot& snapshot, size_t index, std::vector<SceneItemState> items) {
+    const SceneState& old = *snapshot.scenes[index];
+    snapshot.scenes[index] = scene(old.id, old.name, std::move(items));
+}
+
+void unchanged_graph_gives_an_empty_patch() {
+    const SceneGraphSnapshot from = sample();
+    SceneGraphSnapshot to = from;
+    to.revision = 2;
+    CHECK(checked_patch(from, to).empty());
+}
+
+void visibility_and_filters_are_patched_in_place() {
+    const SceneGraphSnapshot from = sample();
+    SceneGraphSnapshot to = from;
+    replace_scene(to, 1, {item(3), item(1, true)});
+    CHECK(checked_patch(from, to) ==
+          json::parse(R"([{"op":"replace","path":"/scenes/1/sources/1/visible","value":true}])"));
+
+    // A filter toggled on the shared camera shows up in both scenes.
+    to = from;
+    add(to, source(1, "Cam \"front\"", from.sources.at(1)->output_flags, {{10, "Blur", false}, {11, "Colour\\Key", true}}));
+    CHECK(checked_patch(from, to).size() == 4);
+
+    // Filters added or reordered, and flags, are replaced whole.
+    to = from;
+    add(to, source(1, "Cam \"front\"", OBS_SOURCE_VIDEO, {{11, "Colour\\Key", false}, {10, "Blur", true}}));
+    CHECK(checked_patch(from, to).size() == 4);
+    add(to, source(2, "Mic\t1", OBS_SOURCE_AUDIO, {{12, "Gain", true}}));
+    checked_patch(from, to);
+}
+
+void items_added_or_removed_replace_the_list() {
+    const SceneGraphSnapshot from = sample();
+    SceneGraphSnapshot to = from;
+    replace_scene(to, 0, {item(2, false), item(1)});
+    CHECK(checked_patch(from, to).size() == 1);
+    replace_scene(to, 0, {item(1)});
+    checked_patch(from, to);
+
+    // The missing source turning up lists its item.
+    to = from;
+    add(to, source(9, "Late"));
+    CHECK(checked_patch(from, to).size() == 1);
+}
+
+void scenes_removed_appended_or_renamed() {
+    SceneGraphSnapshot from = sample();
+    from.scenes.push_back(scene(22, "Outro", {item(2)}));
+
+    SceneGraphSnapshot to = from;
+    to.graph_version = 4;
+    to.scenes.erase(to.scenes.begin() + 1);
+    json patch = checked_patch(from, to);
+    CHECK(patch.size() == 2 && patch[1] == json::parse(R"({"op":"remove","path":"/scenes/1"})"));
+
+    to.scenes.push_back(scene(23, "Credits", {item(3), item(9)}));
+    to.scenes.erase(to.scenes.begin());
+    patch = checked_patch(from, to);
+    CHECK(patch.size() == 4 && patch[3]["op"] == "add" && patch[3]["path"] == "/scenes/-");
+
+    // Same count: compared position by position.
+    to.scenes.push_back(scene(24, "Empty", {}));
+    checked_patch(from, to);
+
+    // A rename hands out a new id for the scene in the same position.
+    to = from;
+    to.scenes[2] = scene(25, "Finale", from.scenes[2]->items);
+    CHECK(checked_patch(from, to).size() == 2);
+}
+
+void reordered_scenes_replace_them_all() {
+    const SceneGraphSnapshot from = sample();
+    SceneGraphSnapshot to = from;
+    std::swap(to.scenes[0], to.scenes[1]);
+    checked_patch(from, to);
+
+    to.scenes.push_back(scene(26, "New", {}));
+    const json patch = checked_patch(from, to);
+    CHECK(patch.size() == 1 && patch[0]["path"] == "/scenes");
+
+    checked_patch(from, SceneGraphSnapshot{});
+    checked_patch(SceneGraphSnapshot{}, from);
+}
+
+} // namespace
+
+int main() {
+    json_writer_matches_dump();
+    obs_state_matches_the_reference();
+    normalized_lists_each_source_once();
+    unchanged_graph_gives_an_empty_patch();
+    visibility_and_filters_are_patched_in_place();
+    items_added_or_removed_replace_the_list();
+    scenes_removed_appended_or_renamed();
+    reordered_scenes_replace_them_all();
+
+    return test_result("obs state json");
+}
@@ -0,0 +1,380 @@
+// ProtocolTest.cpp
+//
+// The wire formats besides event lines: OSC packets decoded into lines, and
+// binary frames, from their varints up through the stream and datagram framing
+// to the commands they parse into, which must match their text form.
+#include "BinaryFraming.hpp"
+#include "LineFraming.hpp"
+#include "NameTable.hpp"
+#include "ObsEvents.hpp"
+#include "Osc.hpp"
+#include "TestCheck.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// NUL-terminated and padded to a multiple of 4 bytes.
+std::string osc_string(std::string_view text) {
+    std::string out(text);
+    out.append(4 - text.size() % 4, '\0');
+    return out;
+}
+
+std::string osc_i32(int32_t value) {
+    const auto bits = static_cast<uint32_t>(value);
+    return {static_cast<char>(bits >> 24), static_cast<char>(bits >> 16), static_cast<char>(bits >> 8),
+            static_cast<char>(bits)};
+}
+
+// A message with string arguments only.
+std::string osc_message(std::string_view address, std::initializer_list<std::string_view> args) {
+    std::string out = osc_string(address) + osc_string("," + std::string(args.size(), 's'));
+    for (const std::string_view arg : args) out += osc_string(arg);
+    return out;
+}
+
+std::string osc_bundle(std::initializer_list<std::string> elements) {
+    std::string out = osc_string("#bundle") + std::string(7, '\0') + '\1';
+    for (const std::string& element : elements) out += osc_i32(static_cast<int32_t>(element.size())) + element;
+    return out;
+}
+
+// The lines a packet decodes into; ok is decode_osc_packet()'s result.
+std::vector<std::string> osc_lines(const std::string& packet, bool& ok, size_t stop_after = SIZE_MAX) {
+    std::vector<std::string> lines;
+    std::string scratch;
+    ok = decode_osc_packet(packet.data(), packet.size(), scratch, [&](std::string_view line) {
+        lines.emplace_back(line);
+        return lines.size() < stop_after;
+    });
+    return lines;
+}
+
+std::vector<std::string> osc_lines(const std::string& packet) {
+    bool ok = false;
+    std::vector<std::string> lines = osc_lines(packet, ok);
+    CHECK(ok);
+    return lines;
+}
+
+void osc_addresses_map_onto_commands() {
+    CHECK(osc_lines(osc_message("/show_source", {"Scene", "Source"})) ==
+          std::vector<std::string>{"show_source -scene_name Scene -source_name Source"});
+    CHECK(osc_lines(osc_message("/obs/toggle_filter", {"Source", "Blur"})) ==
+          std::vector<std::string>{"toggle_filter -source_name Source -filter_name Blur"});
+    CHECK(osc_lines(osc_message("/switch_scene", {"Scene"})) ==
+          std::vector<std::string>{"switch_scene -scene_name Scene"});
+    // Positionals past the command's own are ignored.
+    CHECK(osc_lines(osc_message("/switch_scene", {"Scene", "extra"})) ==
+          std::vector<std::string>{"switch_scene -scene_name Scene"});
+}
+
+void osc_dash_arguments_pass_through() {
+    CHECK(osc_lines(osc_message("/hide_source", {"-source_name", "A", "-scene_name", "S"})) ==
+          std::vector<std::string>{"hide_source -source_name A -scene_name S"});
+
+    // Integers are formatted as text.
+    const std::string packet = osc_string("/show_source") + osc_string(",sssi") + osc_string("-source_name") +
+                               osc_string("A") + osc_string("-in_ms") + osc_i32(250);
+    CHECK(osc_lines(packet) == std::vector<std::string>{"show_source -source_name A -in_ms 250"});
+}
+
+void osc_other_addresses_carry_raw_lines() {
+    CHECK(osc_lines(osc_message("/trigger", {"show_source -source_name A\r\n\nhide_source -source_name B", "begin"})) ==
+          (std::vector<std::string>{"show_source -source_name A", "hide_source -source_name B", "begin"}));
+}
+
+void osc_bundles_keep_their_order() {
+    const std::string packet = osc_bundle({
+        osc_message("/show_source", {"S", "A"}),
+        osc_bundle({osc_message("/hide_source", {"S", "B"}), osc_message("/trigger", {"commit"})}),
+        osc_message("/switch_scene", {"S"}),
+    });
+    CHECK(osc_lines(packet) == (std::vector<std::string>{"show_source -scene_name S -source_name A",
+                                                          "hide_source -scene_name S -source_name B", "commit",
+                                                          "switch_scene -scene_name S"}));
+
+    // The sink may stop decoding half way.
+    bool ok = false;
+    CHECK(osc_lines(packet, ok, 2).size() == 2 && ok);
+}
+
+void malformed_osc_is_rejected() {
+    bool ok = true;
+    const std::string message = osc_message("/show_source", {"Scene", "Source"});
+    // Cut inside the last argument.
+    osc_lines(message.substr(0, message.size() - 4), ok);
+    CHECK(!ok);
+    // No type tags.
+    osc_lines(osc_string("/show_source"), ok);
+    CHECK(!ok);
+    osc_lines(osc_string("/show_source") + osc_string("s") + osc_string("A"), ok);
+    CHECK(!ok);
+    // A tag of unknown size.
+    osc_lines(osc_string("/show_source") + osc_string(",x") + osc_string("A"), ok);
+    CHECK(!ok);
+    // Not an address.
+    osc_lines(osc_message("show_source", {"A"}), ok);
+    CHECK(!ok);
+    // An element larger than the bundle.
+    std::string bundle = osc_bundle({message});
+    bundle.resize(bundle.size() - 4);
+    osc_lines(bundle, ok);
+    CHECK(!ok);
+
+    // Bundles nest four deep at most.
+    std::string nested = message;
+    for (int depth = 0; depth < 4; ++depth) nested = osc_bundle({nested});
+    CHECK(osc_lines(nested).size() == 1);
+    osc_lines(osc_bundle({nested}), ok);
+    CHECK(!ok);
+}
+
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+VarintResult read(const std::string& bytes, uint64_t& value, size_t& size) {
+    return read_varint(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size(), value, size);
+}
+
+void varints_round_trip() {
+    const std::pair<uint64_t, size_t> cases[] = {
+        {0, 1}, {1, 1}, {127, 1}, {128, 2}, {300, 2}, {16383, 2}, {16384, 3}, {uint64_t(1) << 32, 5}, {UINT64_MAX, 10},
+    };
+    for (const auto& [expected, expected_size] : cases) {
+        std::string bytes;
+        put_varint(bytes, expected);
+        CHECK(bytes.size() == expected_size);
+        // Whatever follows is left alone.
+        bytes += '\x7f';
+        uint64_t value = 0;
+        size_t size = 0;
+        CHECK(read(bytes, value, size) == VarintResult::Ok && value == expected && size == expected_size);
+    }
+    uint64_t value = 0;
+    size_t size = 0;
+    CHECK(read("\xac\x02", value, size) == VarintResult::Ok && value == 300 && size == 2);
+}
+
+void short_and_long_varints() {
+    uint64_t value = 0;
+    size_t size = 0;
+    CHECK(read("", value, size) == VarintResult::Incomplete);
+    CHECK(read("\x80", value, size) == VarintResult::Incomplete);
+    CHECK(read(std::string(kMaxVarintSize - 1, '\x80'), value, size) == VarintResult::Incomplete);
+    CHECK(read(std::string(kMaxVarintSize, '\x80'), value, size) == VarintResult::Malformed);
+    CHECK(read(std::string(kMaxVarintSize, '\x80') + '\x01', value, size) == VarintResult::Malformed);
+}
+
+struct Field {
+    ArgKey key;
+    std::string name;     // a name field, unless by_id or numeric
+    uint64_t number = 0;  // the id, or the value of a numeric field
+    bool by_id = false;
+    bool numeric = false;
+};
+
+Field name(ArgKey key, std::string value) { return Field{key, std::move(value)}; }
+Field id(ArgKey key, NameId value) { return Field{key, {}, value, true, false}; }
+Field number(ArgKey key, uint64_t value) { return Field{key, {}, value, false, true}; }
+
+// Fields must come in ArgKey order, as the mask lists them.
+std::string binary_command(EventType type, std::initializer_list<Field> fields) {
+    uint8_t mask = 0;
+    std::string body;
+    for (const Field& field : fields) {
+        mask |= static_cast<uint8_t>(1u << static_cast<unsigned>(field.key));
+        if (field.numeric) {
+            put_varint(body, field.number);
+        } else if (field.by_id) {
+            put_varint(body, field.number << 1 | 1);
+        } else {
+            put_varint(body, field.name.size() << 1);
+            body += field.name;
+        }
+    }
+    std::string out;
+    out += static_cast<char>(type);
+    out += static_cast<char>(mask);
+    return out + body;
+}
+
+std::string framed(const std::string& payload) {
+    std::string out;
+    put_varint(out, payload.size());
+    return out + payload;
+}
+
+bool same_commands(const std::vector<EventCommand>& a, const std::vector<EventCommand>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].type != b[i].type || a[i].flags != b[i].flags || a[i].origin != b[i].origin ||
+            a[i].scene != b[i].scene || a[i].source != b[i].source || a[i].filter != b[i].filter ||
+            (a[i].due_ns != 0) != (b[i].due_ns != 0) || (a[i].expires_ns != 0) != (b[i].expires_ns != 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void frames_parse_like_their_text_form() {
+    const std::string frame =
+        binary_command(EventType::ShowSource, {name(ArgKey::SceneName, "S"), name(ArgKey::SourceName, "A")}) +
+        binary_command(EventType::HideFilter, {name(ArgKey::SourceName, "A"), name(ArgKey::FilterName, "F"),
+                                               number(ArgKey::InMs, 250), number(ArgKey::TtlMs, 1000)}) +
+        binary_command(EventType::SwitchScene, {name(ArgKey::SceneName, "S"), number(ArgKey::Priority, 1)});
+    std::vector<EventCommand> binary;
+    CHECK(parse_event_frame(frame, 7, binary) == 3);
+
+    std::vector<EventCommand> text;
+    parse_event_line("show_source -scene_name S -source_name A; "
+                     "hide_filter -source_name A -filter_name F -in_ms 250 -ttl_ms 1000; "
+                     "switch_scene -scene_name S -priority high",
+                     7, text);
+    CHECK(same_commands(binary, text));
+    CHECK(binary.size() == 3 && !(binary[0].flags & kCommandEndsLine) && (binary[2].flags & kCommandEndsLine));
+    CHECK(binary.size() == 3 && lane_of(binary[0]) == Lane::High);
+}
+
+void frame_fields_by_id() {
+    NameId source = kNoName;
+    CHECK(intern_name("By Id", source));
+    std::vector<EventCommand> commands;
+    // #id needs -version, and the version must be current (1 in the mock).
+    CHECK(parse_event_frame(binary_command(EventType::ShowSource, {id(ArgKey::SourceName, source)}), 1, commands) == 0);
+    CHECK(parse_event_frame(binary_command(EventType::ShowSource,
+                                           {id(ArgKey::SourceName, source), number(ArgKey::Version, 2)}),
+                            1, commands) == 0);
+    CHECK(parse_event_frame(binary_command(EventType::ShowSource,
+                                           {id(ArgKey::SourceName, source), number(ArgKey::Version, 1)}),
+                            1, commands) == 1);
+    CHECK(commands.size() == 1 && commands[0].source == source);
+}
+
+void bad_commands_are_skipped() {
+    const std::string good = binary_command(EventType::ShowSource, {name(ArgKey::SourceName, "A")});
+    std::vector<EventCommand> commands;
+    // Unknown opcode, missing required name, unknown lane: each skipped alone.
+    std::string frame = binary_command(static_cast<EventType>(200), {name(ArgKey::SourceName, "A")}) + good +
+                        binary_command(EventType::ShowFilter, {name(ArgKey::SourceName, "A")}) + good +
+                        binary_command(EventType::ShowSource, {name(ArgKey::SourceName, "A"), number(ArgKey::Priority, 2)});
+    CHECK(parse_event_frame(frame, 1, commands) == 2);
+
+    // A field cut short, or a varint that never ends, leaves no way to go on.
+    commands.clear();
+    std::string cut = good;
+    cut.pop_back();
+    CHECK(parse_event_frame(good + cut, 1, commands) == 1);
+    CHECK(parse_event_frame(good + std::string("\x00\x02", 2) + std::string(kMaxVarintSize, '\x80') + good, 1, commands) == 1);
+    CHECK(commands.size() == 2 && (commands[1].flags & kCommandEndsLine));
+
+    CHECK(parse_event_frame("", 1, commands) == 0);
+}
+
+struct Received {
+    std::vector<std::string> frames;
+    size_t ends = 0;
+};
+
+LineSink collect(Received& received) {
+    return [&received](EventMessage message, MessageFormat format, uint16_t) {
+        if (format == MessageFormat::End) {
+            ++received.ends;
+        } else {
+            CHECK(format == MessageFormat::Frame);
+            received.frames.emplace_back(message.view());
+        }
+        return true;
+    };
+}
+
+void streams_split_into_frames() {
+    const std::string first = binary_command(EventType::ShowSource, {name(ArgKey::SourceName, "A")});
+    const std::string second(300, 'x');
+    const std::string stream = std::string(1, static_cast<char>(kBinaryFramingMagic)) + framed(first) + framed("") +
+                               framed(second);
+
+    // Any split of the bytes gives the same frames; empty ones are dropped.
+    for (const size_t chunk : {size_t(1), size_t(2), size_t(7), stream.size()}) {
+        Received received;
+        const LineSink sink = collect(received);
+        LineAssembler assembler;
+        for (size_t at = 0; at < stream.size(); at += chunk) {
+            CHECK(assembler.append(stream.data() + at, std::min(chunk, stream.size() - at), sink));
+        }
+        CHECK(received.frames == (std::vector<std::string>{first, second}));
+        CHECK(assembler.finish(sink) && received.ends == 1);
+    }
+}
+
+void stream_frames_too_long_or_malformed() {
+    Received received;
+    const LineSink sink = collect(received);
+    LineAssembler assembler;
+    const std::string after = "after";
+    const std::string stream = std::string(1, static_cast<char>(kBinaryFramingMagic)) +
+                               framed(std::string(kMaxFrameSize + 1, 'x')) + framed(after);
+    CHECK(assembler.append(stream.data(), stream.size(), sink));
+    CHECK(received.frames == std::vector<std::string>{after});
+
+    // No way to find the next frame after a bad length.
+    const std::string broken = std::string(kMaxVarintSize, '\x80') + framed(after);
+    CHECK(assembler.append(broken.data(), broken.size(), sink));
+    CHECK(assembler.append(framed(after).data(), framed(after).size(), sink));
+    CHECK(received.frames.size() == 1);
+
+    // A partial frame at the end is dropped.
+    LineAssembler partial;
+    const std::string cut = std::string(1, static_cast<char>(kBinaryFramingMagic)) + framed(after).substr(0, 3);
+    CHECK(partial.append(cut.data(), cut.size(), sink));
+    CHECK(partial.finish(sink));
+    CHECK(received.frames.size() == 1 && received.ends == 1);
+}
+
+void datagrams_split_into_frames() {
+    Received received;
+    const LineSink sink = collect(received);
+    SlabWriter writer;
+    std::string scratch;
+    const std::string magic(1, static_cast<char>(kBinaryFramingMagic));
+
+    const std::string datagram = magic + framed("one") + framed(std::string(kMaxFrameSize + 1, 'x')) + framed("two");
+    CHECK(deliver_datagram(datagram.data(), datagram.size(), 3, sink, writer, scratch));
+    CHECK(received.frames == (std::vector<std::string>{"one", "two"}) && received.ends == 1);
+
+    // A length past the end drops the rest; the End still follows.
+    const std::string cut = magic + framed("three") + framed("four").substr(0, 3);
+    CHECK(deliver_datagram(cut.data(), cut.size(), 3, sink, writer, scratch));
+    CHECK(received.frames.size() == 3 && received.frames.back() == "three" && received.ends == 2);
+}
+
+} // namespace
+
+int main() {
+    osc_addresses_map_onto_commands();
+    osc_dash_arguments_pass_through();
+    osc_other_addresses_carry_raw_lines();
+    osc_bundles_keep_their_order();
+    malformed_osc_is_rejected();
+    varints_round_trip();
+    short_and_long_varints();
+    frames_parse_like_their_text_form();
+    frame_fields_by_id();
+    bad_commands_are_skipped();
+    streams_split_into_frames();
+    stream_frames_too_long_or_malformed();
+    datagrams_split_into_frames();
+
+    return test_result("protocol");
+}
@@ -0,0 +1,26 @@
+// TestCheck.hpp
+#pragma once
+
+#include <cstdio>
+
+// Minimal assertions for the test executables: a failed CHECK is reported
+// and counted, and the test goes on; main() returns test_result().
+
+inline int g_failures = 0;
+
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        if (!(condition)) {                                                                \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++g_failures;                                                                  \
+        }                                                                                  \
+    } while (false)
+
+inline int test_result(const char* name) {
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d checks failed\n", g_failures);
+        return 1;
+    }
+    std::printf("all %s tests passed\n", name);
+    return 0;
+}
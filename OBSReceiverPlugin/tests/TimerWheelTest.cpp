@@ -0,0 +1,200 @@
+// TimerWheelTest.cpp
+//
+// TimerWheel against a std::multimap of the same values: whatever is
+// scheduled fires on the advance that passes its tick, in due order, across
+// cascades and for values parked out of range. Within a tick only values
+// scheduled back to back are promised to stay together and in order; one that
+// cascades down may land behind one scheduled later but filed lower.
+#include "TimerWheel.hpp"
+#include "TestCheck.hpp"
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Wheel = TimerWheel<uint64_t>;
+
+// Mirrors the wheel; every value is a unique id.
+class Reference {
+public:
+    explicit Reference(uint64_t resolution_ns) : resolution_ns_(resolution_ns) {}
+
+    bool schedule(uint64_t due_ns, uint64_t id) {
+        const uint64_t tick = due_ns / resolution_ns_;
+        if (tick <= now_tick_) return false;
+        due_.emplace(tick, id);
+        tick_of_[id] = tick;
+        return true;
+    }
+
+    std::vector<uint64_t> advance(uint64_t now_ns) {
+        std::vector<uint64_t> fired;
+        const uint64_t target = now_ns / resolution_ns_;
+        if (target <= now_tick_) return fired;
+        now_tick_ = target;
+        const auto end = due_.upper_bound(target);
+        for (auto it = due_.begin(); it != end; ++it) fired.push_back(it->second);
+        due_.erase(due_.begin(), end);
+        return fired;
+    }
+
+    size_t size() const { return due_.size(); }
+
+    uint64_t tick_of(uint64_t id) const { return tick_of_.at(id); }
+
+private:
+    const uint64_t resolution_ns_;
+    uint64_t now_tick_ = 0;
+    std::multimap<uint64_t, uint64_t> due_;
+    std::unordered_map<uint64_t, uint64_t> tick_of_;
+};
+
+struct Checked {
+    explicit Checked(uint64_t resolution_ns) : wheel(resolution_ns), reference(resolution_ns) {}
+
+    void schedule(uint64_t due_ns) {
+        uint64_t id = next_id++;
+        advances_before[id] = advances;
+        const bool expected = reference.schedule(due_ns, id);
+        CHECK(wheel.schedule(due_ns, id) == expected);
+    }
+
+    void advance(uint64_t now_ns) {
+        ++advances;
+        std::vector<uint64_t> fired;
+        wheel.advance(now_ns, [&](uint64_t& id) { fired.push_back(id); });
+        const std::vector<uint64_t> expected = reference.advance(now_ns);
+        CHECK(wheel.size() == reference.size());
+        CHECK(fired.size() == expected.size());
+        if (fired.size() != expected.size()) return;
+
+        std::unordered_map<uint64_t, size_t> position;
+        for (size_t i = 0; i < fired.size(); ++i) {
+            position[fired[i]] = i;
+            CHECK(reference.tick_of(fired[i]) == reference.tick_of(expected[i]));
+        }
+        for (const uint64_t id : expected) {
+            CHECK(position.count(id) == 1);
+            // id + 1 was scheduled right after id, for the same tick and
+            // with no advance in between.
+            const auto next = position.find(id + 1);
+            if (next != position.end() && reference.tick_of(id + 1) == reference.tick_of(id) &&
+                advances_before[id + 1] == advances_before[id]) {
+                CHECK(next->second == position[id] + 1);
+            }
+        }
+    }
+
+    Wheel wheel;
+    Reference reference;
+    uint64_t next_id = 0;
+    uint64_t advances = 0;
+    std::unordered_map<uint64_t, uint64_t> advances_before;
+};
+
+void fires_in_due_order_within_a_level() {
+    Checked checked(1);
+    for (const uint64_t due : {5, 3, 9, 3, 63, 1, 5}) checked.schedule(due);
+    checked.advance(4);
+    checked.advance(63);
+    CHECK(checked.wheel.empty());
+}
+
+void cascades_keep_schedule_order() {
+    Checked checked(1);
+    // One per level, and several sharing a far tick.
+    for (const uint64_t due : {4096 + 7, 100, 262144 + 3, 4096 + 7, 70, 262144 + 3, 4096 + 7}) checked.schedule(due);
+    checked.advance(64);
+    checked.advance(4095);
+    checked.advance(4096 + 7);
+    checked.advance(262144 + 2);
+    checked.advance(262144 + 3);
+    CHECK(checked.wheel.empty());
+}
+
+void values_out_of_range_are_parked() {
+    Checked checked(1);
+    checked.advance(5);
+    for (const uint64_t due : {Wheel::kSpanTicks * 3 + 11, Wheel::kSpanTicks + 4, Wheel::kSpanTicks * 3 + 11}) {
+        checked.schedule(due);
+    }
+    checked.schedule(Wheel::kSpanTicks - 1);
+    checked.advance(Wheel::kSpanTicks);
+    checked.advance(Wheel::kSpanTicks + 3);
+    checked.advance(Wheel::kSpanTicks + 4);
+    checked.advance(Wheel::kSpanTicks * 3 + 10);
+    CHECK(checked.wheel.size() == 2);
+    checked.advance(Wheel::kSpanTicks * 3 + 11);
+    CHECK(checked.wheel.empty());
+}
+
+void advancing_backwards_is_a_no_op() {
+    Checked checked(1'000'000);
+    checked.advance(50'000'000);
+    checked.schedule(60'000'000);
+    checked.advance(10'000'000);
+    // Still not due: the clock stayed at 50 ms.
+    checked.schedule(40'000'000);
+    checked.schedule(55'500'000);
+    checked.advance(59'999'999);
+    checked.advance(60'000'000);
+    CHECK(checked.wheel.empty());
+}
+
+void schedule_at_or_before_now_is_refused() {
+    Checked checked(1'000'000);
+    checked.advance(10'000'000);
+    checked.schedule(10'999'999); // same tick
+    checked.schedule(11'000'000);
+    CHECK(checked.wheel.size() == 1);
+}
+
+// Random schedules and advances, with the far ones rare enough that walking
+// the wheel tick by tick stays quick.
+void matches_the_reference() {
+    std::mt19937_64 random(20261016);
+    Checked checked(1);
+    uint64_t now = 0;
+    for (int step = 0; step < 20000; ++step) {
+        const uint64_t pick = random() % 100;
+        if (pick < 60) {
+            uint64_t delta;
+            if (pick < 30) delta = random() % 64;
+            else if (pick < 45) delta = random() % 4096;
+            else if (pick < 55) delta = random() % 262144;
+            else if (pick < 59) delta = random() % Wheel::kSpanTicks;
+            else delta = random() % (Wheel::kSpanTicks * 3);
+            // Now and then a few back to back.
+            const uint64_t count = random() % 8 == 0 ? 3 : 1;
+            for (uint64_t i = 0; i < count; ++i) checked.schedule(now + delta);
+        } else if (pick < 97) {
+            now += random() % 512;
+            checked.advance(now);
+        } else if (pick < 99) {
+            checked.advance(now - random() % (now + 1));
+        } else {
+            now += random() % 300000;
+            checked.advance(now);
+        }
+    }
+    now += Wheel::kSpanTicks * 4;
+    checked.advance(now);
+    CHECK(checked.wheel.empty());
+}
+
+} // namespace
+
+int main() {
+    fires_in_due_order_within_a_level();
+    cascades_keep_schedule_order();
+    values_out_of_range_are_parked();
+    advancing_backwards_is_a_no_op();
+    schedule_at_or_before_now_is_refused();
+    matches_the_reference();
+
+    return test_result("timer wheel");
+}
@@ -0,0 +1,8 @@
+// obs-frontend-api.h (test mock)
+#pragma once
+
+#include <obs-module.h>
+
+extern "C" {
+void obs_frontend_set_current_scene(obs_source_t* scene);
+}
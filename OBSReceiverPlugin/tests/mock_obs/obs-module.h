@@ -0,0 +1,65 @@
+// obs-module.h (test mock)
+#pragma once
+
+// The slice of the libobs API the event pipeline uses, backed by MockObs.cpp.
+// Sources and scene items are plain structs the tests create by name.
+
+#include <cstdarg>
+#include <cstdint>
+
+#define OBS_DECLARE_MODULE()
+#define OBS_MODULE_USE_DEFAULT_LOCALE(name, locale)
+
+// Source output flags, as libobs numbers them.
+#define OBS_SOURCE_VIDEO                    (1 << 0)
+#define OBS_SOURCE_AUDIO                    (1 << 1)
+#define OBS_SOURCE_ASYNC                    (1 << 2)
+#define OBS_SOURCE_CUSTOM_DRAW              (1 << 3)
+#define OBS_SOURCE_INTERACTION              (1 << 5)
+#define OBS_SOURCE_COMPOSITE                (1 << 6)
+#define OBS_SOURCE_DO_NOT_DUPLICATE         (1 << 7)
+#define OBS_SOURCE_DEPRECATED               (1 << 8)
+#define OBS_SOURCE_DO_NOT_SELF_MONITOR      (1 << 9)
+#define OBS_SOURCE_CAP_DISABLED             (1 << 10)
+#define OBS_SOURCE_MONITOR_BY_DEFAULT       (1 << 12)
+#define OBS_SOURCE_SUBMIX                   (1 << 13)
+#define OBS_SOURCE_CONTROLLABLE_MEDIA       (1 << 14)
+#define OBS_SOURCE_CEA_708                  (1 << 15)
+#define OBS_SOURCE_SRGB                     (1 << 16)
+#define OBS_SOURCE_CAP_DONT_SHOW_PROPERTIES (1 << 17)
+#define OBS_SOURCE_REQUIRES_CANVAS          (1 << 18)
+
+enum {
+    LOG_ERROR = 100,
+    LOG_WARNING = 200,
+    LOG_INFO = 300,
+    LOG_DEBUG = 400,
+};
+
+enum obs_task_type {
+    OBS_TASK_UI,
+    OBS_TASK_GRAPHICS,
+    OBS_TASK_AUDIO,
+    OBS_TASK_DESTROY,
+};
+
+typedef struct obs_source obs_source_t;
+typedef struct obs_scene_item obs_sceneitem_t;
+typedef void (*obs_task_t)(void* param);
+
+extern "C" {
+void blog(int log_level, const char* format, ...);
+
+void obs_queue_task(enum obs_task_type type, obs_task_t task, void* param, bool wait);
+void obs_enter_graphics(void);
+void obs_leave_graphics(void);
+uint64_t obs_get_frame_interval_ns(void);
+
+void obs_source_release(obs_source_t* source);
+bool obs_source_enabled(const obs_source_t* source);
+void obs_source_set_enabled(obs_source_t* source, bool enabled);
+
+void obs_sceneitem_release(obs_sceneitem_t* item);
+bool obs_sceneitem_visible(const obs_sceneitem_t* item);
+bool obs_sceneitem_set_visible(obs_sceneitem_t* item, bool visible);
+}
@@ -0,0 +1,7 @@
+// util/platform.h (test mock)
+#pragma once
+
+#include <cstdint>
+
+// A clock the tests advance by hand; see mock_obs_advance_ns().
+extern "C" uint64_t os_gettime_ns(void);